@@ -0,0 +1,173 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+// Arenas: one large mapping reserved up front and carved by a bump pointer
+// The data array, the scratch buffers and one small slice per worker come out
+// of a single region whose page size is picked with -H:
+//   4k      ordinary pages (default)
+//   thp     madvise(MADV_HUGEPAGE), transparent huge pages where the kernel allows
+//   huge    MAP_HUGETLB from the reserved hugetlbfs pool; falls back to thp
+//           when the pool is too small
+// Huge pages cut TLB misses and turn 512 first-touch faults into one. With
+// -P the workers prefault their own slices in parallel before any timed run.
+// Kernels get temporaries from scratch_alloc(), served by the calling
+// worker's slice once bind_scratch() gave it one, by malloc() otherwise;
+// scratch_free() releases in reverse order of allocation.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define HUGE_PAGE_SIZE (2UL << 20)
+#define ARENA_ALIGN 64              // Every allocation starts on its own cache line
+#define WORKER_ARENA_BYTES HUGE_PAGE_SIZE   // Scratch slice of each worker
+
+// Page Sizes
+#define PAGES_4K 0
+#define PAGES_THP 1
+#define PAGES_HUGETLB 2
+#define PAGE_MODES 3
+
+static const char *const page_mode_names[PAGE_MODES] = {"4k", "thp", "huge"};
+
+// Returns PAGES_* for name, -1 if unknown
+static inline int parse_page_mode(const char *name) {
+    for (int m = 0; m < PAGE_MODES; m++) {
+        if (strcmp(name, page_mode_names[m]) == 0) {
+            return m;
+        }
+    }
+    return -1;
+}
+
+typedef struct {
+    char *base;
+    size_t size;
+    size_t used;
+    int pages;                      // PAGES_* actually backing it
+} Arena;
+
+// Maps bytes of anonymous memory with the page size of mode, shared across
+// fork() if shared is set; records the page size it got in arena->pages
+// 4k and thp pages are reserved lazily, like map_elements()
+static inline void arena_reserve(Arena *arena, size_t bytes, int shared, int mode) {
+    int flags = MAP_ANONYMOUS | MAP_NORESERVE | (shared ? MAP_SHARED : MAP_PRIVATE);
+    arena->used = 0;
+    arena->size = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    arena->pages = mode;
+    arena->base = MAP_FAILED;
+    if (mode == PAGES_HUGETLB) {
+        // Reserved at map time: with MAP_NORESERVE an empty pool would only
+        // show up as SIGBUS on first touch
+        arena->base = mmap(NULL, arena->size, PROT_READ | PROT_WRITE, (flags & ~MAP_NORESERVE) | MAP_HUGETLB, -1, 0);
+        if (arena->base == MAP_FAILED) {
+            fprintf(stderr, "Note: no %zu MB of hugetlbfs pages (see /proc/sys/vm/nr_hugepages), using thp\n",
+                    arena->size >> 20);
+            arena->pages = PAGES_THP;
+        }
+    }
+    if (arena->base == MAP_FAILED) {
+        arena->base = mmap(NULL, arena->size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (arena->base == MAP_FAILED) {
+            perror("mmap");
+            exit(1);
+        }
+    }
+    if (arena->pages == PAGES_THP) {
+        madvise(arena->base, arena->size, MADV_HUGEPAGE);
+    }
+}
+
+static inline void arena_release(Arena *arena) {
+    munmap(arena->base, arena->size);
+}
+
+// Carves bytes from arena, NULL once it is exhausted
+// Blocks of a huge page or more start on a huge page boundary, so the pages
+// of every large buffer belong to it alone
+static inline void *arena_alloc(Arena *arena, size_t bytes) {
+    size_t align = (bytes >= HUGE_PAGE_SIZE) ? HUGE_PAGE_SIZE : ARENA_ALIGN;
+    size_t start = (arena->used + align - 1) / align * align;
+    if (start + bytes > arena->size) {
+        return NULL;
+    }
+    arena->used = start + bytes;
+    return arena->base + start;
+}
+
+// Whether memory was carved from arena
+static inline int arena_owns(const Arena *arena, const void *memory) {
+    return (const char *)memory >= arena->base && (const char *)memory < arena->base + arena->size;
+}
+
+// arena_alloc() for the fixed layout of a program: running out is a sizing bug
+static inline void *arena_take(Arena *arena, size_t bytes) {
+    void *memory = arena_alloc(arena, bytes);
+    if (memory == NULL) {
+        fprintf(stderr, "Arena of %zu bytes cannot hold %zu more\n", arena->size, bytes);
+        exit(1);
+    }
+    return memory;
+}
+
+// Cuts count sub-arenas of bytes each out of arena, same page size
+static inline void arena_split(Arena *arena, Arena *slices, int count, size_t bytes) {
+    for (int i = 0; i < count; i++) {
+        slices[i].base = arena_take(arena, bytes);
+        slices[i].size = bytes;
+        slices[i].used = 0;
+        slices[i].pages = arena->pages;
+    }
+}
+
+// Faults in every page of memory[0..bytes) for writing; each byte touched is
+// stored back unchanged, so memory may already hold data
+static inline void prefault(void *memory, size_t bytes) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    volatile char *bytes_at = memory;
+    for (size_t offset = 0; offset < bytes; offset += page) {
+        bytes_at[offset] = bytes_at[offset];
+    }
+}
+
+// ---- Worker Scratch ---------------------------------------------------------
+
+static __thread Arena *scratch_arena;   // Slice of the calling worker, NULL for malloc
+
+// Makes the calling thread (or worker process) allocate scratch from slice
+static inline void bind_scratch(Arena *slice) {
+    scratch_arena = slice;
+}
+
+// Temporary buffer for a kernel, from the worker's slice when it has room
+static inline void *scratch_alloc(size_t bytes) {
+    if (scratch_arena != NULL) {
+        void *memory = arena_alloc(scratch_arena, bytes);
+        if (memory != NULL) {
+            return memory;
+        }
+    }
+    return malloc(bytes);
+}
+
+// Zeroed scratch_alloc()
+static inline void *scratch_calloc(size_t count, size_t size) {
+    void *memory = scratch_alloc(count * size);
+    memset(memory, 0, count * size);
+    return memory;
+}
+
+// Returns a scratch_alloc() buffer; releasing an arena buffer also releases
+// everything allocated after it, so free in reverse order
+static inline void scratch_free(void *memory) {
+    Arena *arena = scratch_arena;
+    if (arena != NULL && arena_owns(arena, memory)) {
+        arena->used = (char *)memory - arena->base;
+        return;
+    }
+    free(memory);
+}
+
+#endif
@@ -0,0 +1,72 @@
+#!/bin/sh
+# Builds and runs one program for a chosen element type
+#   ./bench.sh [-t type] program [-n elements] [-w worker,counts] [-r reps] [-f csv] [mode]
+# type is int32 (default), int64, uint64, float or double
+# program is a source file name with or without .c, e.g. max_value_multithreading,
+# "all" to run the five programs in turn (one csv table, or one json object per program),
+# or "check" to test parallel_api.h on both backends against serial references (exit status 1 on failure)
+# Binaries are cached per type in bin/ and rebuilt when a source is newer
+#
+# Example: ./bench.sh -t double parallel_sort_multithreading -n 1e9 -w 1,2,4,8,16 radix
+#          ./bench.sh all -n 1e7 -r 10 -f csv > results.csv
+#          ./bench.sh -t float check -n 1e6 -w 1,3,8
+
+set -e
+cd "$(dirname "$0")"
+
+TYPE=int32
+if [ "$1" = "-t" ]; then
+    TYPE=$2
+    shift 2
+fi
+
+case $TYPE in
+    int32)  FLAGS= ;;
+    int64)  FLAGS=-DELEM_INT64 ;;
+    uint64) FLAGS=-DELEM_UINT64 ;;
+    float)  FLAGS=-DELEM_FLOAT ;;
+    double) FLAGS=-DELEM_DOUBLE ;;
+    *) echo "Unknown type '$TYPE' (expected int32, int64, uint64, float or double)" >&2; exit 1 ;;
+esac
+
+if [ $# -lt 1 ]; then
+    sed -n '2,12p' "$0" | sed 's/^# \{0,1\}//' >&2
+    exit 1
+fi
+PROGRAM=${1%.c}
+shift
+if [ "$PROGRAM" = check ]; then
+    PROGRAM=parallel_api_check
+fi
+
+# Builds bin/<program>.<type> if missing or stale, prints its path
+build() {
+    if [ ! -f "$1.c" ]; then
+        echo "No such program '$1.c'" >&2
+        exit 1
+    fi
+    binary=bin/$1.$TYPE
+    mkdir -p bin
+    if [ ! -x "$binary" ] || [ -n "$(find "$1.c" ./*.h -newer "$binary")" ]; then
+        ${CC:-gcc} -O2 $FLAGS "$1.c" -o "$binary" -lpthread -lm || exit 1
+    fi
+    echo "$binary"
+}
+
+if [ "$PROGRAM" != all ]; then
+    BINARY=$(build "$PROGRAM")
+    exec "$BINARY" "$@"
+fi
+
+# Suite: csv headers after the first are dropped so the tables concatenate
+FIRST=1
+for PROGRAM in max_value_multithreading max_value_multiprocessing max_value_hybrid \
+               parallel_sort_multithreading parallel_sort_multitprocessing; do
+    BINARY=$(build "$PROGRAM")
+    if [ $FIRST = 1 ]; then
+        "$BINARY" "$@"
+    else
+        "$BINARY" "$@" | sed '/^program,mode,/d'
+    fi
+    FIRST=0
+done
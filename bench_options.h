@@ -0,0 +1,326 @@
+#ifndef BENCH_OPTIONS_H
+#define BENCH_OPTIONS_H
+
+// Command line shared by all programs:
+//   program [-n elements] [-w worker,counts] [-r reps] [-u warmups] [-d dist] [-s seed] [-f text|csv|json] [-p] [-m] [-a] [-v]
+//           [-i input] [-W] [-o output] [-b run] [-D] [-k count] [-q count] [-H pages] [-P] [-T thread,counts] [mode]
+// -n takes plain or scientific notation (131072, 1e9); default 131072
+// -w takes a comma separated list of worker counts; default 1,2,4,8
+// -r timed repetitions per worker count (default 5), after -u untimed warmups (default 1)
+// -d input distribution (see data_gen.h), -s its seed; default uniform, 42
+// -f report format; csv and json go to stdout, everything else to stderr
+// -p collects perf_event counters per worker around the map and reduce phases
+// -m reads PSS / USS of every forked child from smaps_rollup before it exits
+// -a pins worker i to a CPU (spreading workers over NUMA nodes) and binds the
+//    pages of the slice it owns to that node; reports per-node bandwidth
+// -v prints per-worker progress lines, which then land inside the timed region
+// -i reads the input from a binary elem_t file instead of generating it; the
+//    in-memory kernels mmap it (see map_file), the external sort streams it
+// -W sorts the -i file in place through a shared writable mapping
+// -o names the external sort's output, a temp file by default
+// -b elements per external sort run (default 16M); memory is about 4 runs
+// -D uses O_DIRECT for the external sort's files, bypassing the page cache
+// -k max programs also answer top-k, k-th largest, p50 and p99 queries, timed apart
+// -q max value threads also build a range max / min index and time count random
+//    range queries per worker and count point updates against it
+// -H page size of the arena holding the array and scratch space (see arena.h):
+//    4k (default), thp or huge
+// -P prefaults the arena with all workers before the timed runs of each config
+// -T takes a comma separated list of threads per worker process for the hybrid
+//    program, which runs every -w process count with every -T thread count; default 1
+// mode is a program specific word, e.g. "radix" or "atomic"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "data_gen.h"
+#include "arena.h"
+
+#define DEFAULT_ARRAY_SIZE 131072
+#define MAX_CONFIGS 64
+#define DEFAULT_REPS 5
+#define DEFAULT_WARMUPS 1
+#define DEFAULT_RUN_ELEMS (1 << 24)
+
+// Report Formats
+#define FORMAT_TEXT 0
+#define FORMAT_CSV 1
+#define FORMAT_JSON 2
+
+typedef struct {
+    size_t n;                       // Elements in array
+    int workers[MAX_CONFIGS];       // Worker count of each config
+    int num_configs;
+    int max_workers;                // Largest entry of workers
+    int threads[MAX_CONFIGS];       // Threads per process of each hybrid config (-T)
+    int num_thread_configs;
+    int max_threads;                // Largest entry of threads
+    int reps;                       // Timed runs per config
+    int warmups;                    // Untimed runs before them
+    int dist;                       // DIST_* of the generated input
+    uint64_t seed;                  // Generator seed
+    int format;                     // FORMAT_TEXT, FORMAT_CSV or FORMAT_JSON
+    int perf;                       // Collect perf_event counters
+    int smaps;                      // Read PSS / USS of forked children
+    int affinity;                   // Pin workers and place slices on their nodes
+    int verbose;                    // Print per-worker progress
+    const char *input;              // Input file, NULL to generate the input
+    int write_back;                 // Sort the input file in place
+    const char *output;             // External sort output file, NULL for a temp file
+    size_t run_elems;               // Elements per external sort run
+    int direct;                     // O_DIRECT for the external sort's files
+    size_t top_k;                   // Values of the top-k query, 0 for no queries
+    size_t range_queries;           // Range index queries per worker, 0 for no index
+    int pages;                      // PAGES_* of the arena
+    int prefault;                   // Fault the arena in before the timed runs
+    const char *mode;               // Optional positional argument, NULL if absent
+} Options;
+
+static inline void print_usage(const char *program, const char *modes) {
+    fprintf(stderr, "Usage: %s [-n elements] [-w worker,counts] [-r reps] [-u warmups] [-d dist] [-s seed] [-f format] [-p] [-m] [-a] [-v]\n"
+                    "       [-i input] [-W] [-o output] [-b run] [-D] [-k count] [-q count] [-H pages] [-P] [-T thread,counts] %s\n",
+            program, modes);
+    fprintf(stderr, "  -n  array size, e.g. 131072 or 1e9 (default %d)\n", DEFAULT_ARRAY_SIZE);
+    fprintf(stderr, "  -w  worker counts to run, e.g. 1,2,4,8 (default)\n");
+    fprintf(stderr, "  -r  timed repetitions per worker count (default %d)\n", DEFAULT_REPS);
+    fprintf(stderr, "  -u  untimed warmup runs per worker count (default %d)\n", DEFAULT_WARMUPS);
+    fprintf(stderr, "  -d  input: uniform (default), full, sorted, reverse, few-unique, zipf or organ-pipe\n");
+    fprintf(stderr, "  -s  input seed (default %d)\n", DEFAULT_SEED);
+    fprintf(stderr, "  -f  report format: text (default), csv or json\n");
+    fprintf(stderr, "  -p  count cycles, instructions, cache / branch misses, context switches and page faults\n");
+    fprintf(stderr, "  -m  read PSS / USS of forked children (page table walk at child exit)\n");
+    fprintf(stderr, "  -a  pin workers to CPUs, place each slice on its worker's NUMA node\n");
+    fprintf(stderr, "  -v  print per-worker progress (slows the timed region)\n");
+    fprintf(stderr, "  -i  binary %s input file, mapped instead of generating -n elements\n", ELEM_NAME);
+    fprintf(stderr, "  -W  sort the -i file in place (runs after the first see sorted input)\n");
+    fprintf(stderr, "  -o  external sort: output file (default: a temp file, removed at exit)\n");
+    fprintf(stderr, "  -b  external sort: elements per run (default %d)\n", DEFAULT_RUN_ELEMS);
+    fprintf(stderr, "  -D  external sort: O_DIRECT file I/O\n");
+    fprintf(stderr, "  -k  max value: also find the k largest values, the k-th largest, p50 and p99\n");
+    fprintf(stderr, "  -q  max value threads: build a range max / min index, time count queries per worker\n");
+    fprintf(stderr, "  -H  arena pages: 4k (default), thp (madvise) or huge (MAP_HUGETLB, else thp)\n");
+    fprintf(stderr, "  -P  prefault the arena with all workers before each worker count's runs\n");
+    fprintf(stderr, "  -T  hybrid: threads per process to run with every -w process count, e.g. 1,2,4 (default 1)\n");
+}
+
+// Parses a comma separated list of positive counts such as "1,2,4" into
+// counts, returns how many there were, 0 if the list is invalid
+static inline int parse_count_list(const char *text, int *counts) {
+    int n = 0;
+    char *list = strdup(text);
+    for (char *tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        int count = atoi(tok);
+        if (count < 1 || n == MAX_CONFIGS) {
+            free(list);
+            return 0;
+        }
+        counts[n++] = count;
+    }
+    free(list);
+    return n;
+}
+
+// Parses argv into opts, returns 0 on success
+static inline int parse_options(int argc, char *argv[], Options *opts, const char *modes) {
+    opts->n = DEFAULT_ARRAY_SIZE;
+    opts->num_configs = 0;
+    opts->mode = NULL;
+    opts->reps = DEFAULT_REPS;
+    opts->warmups = DEFAULT_WARMUPS;
+    opts->dist = DIST_UNIFORM;
+    opts->seed = DEFAULT_SEED;
+    opts->format = FORMAT_TEXT;
+    opts->perf = 0;
+    opts->smaps = 0;
+    opts->affinity = 0;
+    opts->verbose = 0;
+    opts->input = NULL;
+    opts->write_back = 0;
+    opts->output = NULL;
+    opts->run_elems = DEFAULT_RUN_ELEMS;
+    opts->direct = 0;
+    opts->top_k = 0;
+    opts->range_queries = 0;
+    opts->pages = PAGES_4K;
+    opts->prefault = 0;
+    opts->threads[0] = 1;
+    opts->num_thread_configs = 1;
+    for (int w = 1; w <= 8; w *= 2) {
+        opts->workers[opts->num_configs++] = w;
+    }
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:r:u:d:s:f:pmavi:Wo:b:Dk:q:H:PT:h")) != -1) {
+        if (opt == 'n' || opt == 'b' || opt == 'k' || opt == 'q') {
+            char *end;
+            double n = strtod(optarg, &end);
+            if (*end != '\0' || n < 1 || n != (double)(size_t)n) {
+                fprintf(stderr, "Invalid %s '%s'\n",
+                        (opt == 'n') ? "array size" : (opt == 'b') ? "run size" :
+                        (opt == 'k') ? "top-k count" : "query count", optarg);
+                return 1;
+            }
+            if (opt == 'n') {
+                opts->n = (size_t)n;
+            } else if (opt == 'b') {
+                opts->run_elems = (size_t)n;
+            } else if (opt == 'k') {
+                opts->top_k = (size_t)n;
+            } else {
+                opts->range_queries = (size_t)n;
+            }
+        } else if (opt == 'w' || opt == 'T') {
+            int *counts = (opt == 'w') ? opts->workers : opts->threads;
+            int *num = (opt == 'w') ? &opts->num_configs : &opts->num_thread_configs;
+            *num = parse_count_list(optarg, counts);
+            if (*num == 0) {
+                fprintf(stderr, "Invalid %s list '%s'\n", (opt == 'w') ? "worker" : "thread", optarg);
+                return 1;
+            }
+        } else if (opt == 'r' || opt == 'u') {
+            char *end;
+            long count = strtol(optarg, &end, 10);
+            if (*end != '\0' || count < (opt == 'r' ? 1 : 0) || count > 1000000) {
+                fprintf(stderr, "Invalid %s count '%s'\n", (opt == 'r') ? "repetition" : "warmup", optarg);
+                return 1;
+            }
+            if (opt == 'r') {
+                opts->reps = (int)count;
+            } else {
+                opts->warmups = (int)count;
+            }
+        } else if (opt == 'd') {
+            opts->dist = parse_distribution(optarg);
+            if (opts->dist < 0) {
+                fprintf(stderr, "Unknown distribution '%s' (expected uniform, full, sorted, reverse, "
+                                "few-unique, zipf or organ-pipe)\n", optarg);
+                return 1;
+            }
+        } else if (opt == 's') {
+            char *end;
+            opts->seed = strtoull(optarg, &end, 0);
+            if (*end != '\0' || *optarg == '\0') {
+                fprintf(stderr, "Invalid seed '%s'\n", optarg);
+                return 1;
+            }
+        } else if (opt == 'f') {
+            if (strcmp(optarg, "text") == 0) {
+                opts->format = FORMAT_TEXT;
+            } else if (strcmp(optarg, "csv") == 0) {
+                opts->format = FORMAT_CSV;
+            } else if (strcmp(optarg, "json") == 0) {
+                opts->format = FORMAT_JSON;
+            } else {
+                fprintf(stderr, "Unknown format '%s' (expected text, csv or json)\n", optarg);
+                return 1;
+            }
+        } else if (opt == 'p') {
+            opts->perf = 1;
+        } else if (opt == 'm') {
+            opts->smaps = 1;
+        } else if (opt == 'a') {
+            opts->affinity = 1;
+        } else if (opt == 'v') {
+            opts->verbose = 1;
+        } else if (opt == 'i') {
+            opts->input = optarg;
+        } else if (opt == 'W') {
+            opts->write_back = 1;
+        } else if (opt == 'o') {
+            opts->output = optarg;
+        } else if (opt == 'D') {
+            opts->direct = 1;
+        } else if (opt == 'H') {
+            opts->pages = parse_page_mode(optarg);
+            if (opts->pages < 0) {
+                fprintf(stderr, "Unknown page size '%s' (expected 4k, thp or huge)\n", optarg);
+                return 1;
+            }
+        } else if (opt == 'P') {
+            opts->prefault = 1;
+        } else {
+            print_usage(argv[0], modes);
+            return 1;
+        }
+    }
+    if (optind < argc) {
+        opts->mode = argv[optind];
+    }
+
+    if (opts->write_back && opts->input == NULL) {
+        fprintf(stderr, "-W sorts the -i file in place and needs -i\n");
+        return 1;
+    }
+    if (opts->write_back && opts->reps + opts->warmups > 1) {
+        fprintf(stderr, "Note: -W sorts the file in place, so runs after the first see sorted input\n");
+    }
+
+    opts->max_workers = 0;
+    for (int c = 0; c < opts->num_configs; c++) {
+        if (opts->workers[c] > opts->max_workers) {
+            opts->max_workers = opts->workers[c];
+        }
+    }
+    opts->max_threads = 0;
+    for (int c = 0; c < opts->num_thread_configs; c++) {
+        if (opts->threads[c] > opts->max_threads) {
+            opts->max_threads = opts->threads[c];
+        }
+    }
+
+    // More workers than cores still runs, but will not scale
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (opts->max_workers > cores) {
+        fprintf(stderr, "Note: %d workers requested, %ld cores online\n", opts->max_workers, cores);
+    }
+    return 0;
+}
+
+// Maps count elements of size bytes each, shared across fork() if shared is set
+// Pages are reserved lazily so very large arrays only cost what is touched
+static inline void *map_elements(size_t count, size_t size, int shared) {
+    int flags = MAP_ANONYMOUS | MAP_NORESERVE | (shared ? MAP_SHARED : MAP_PRIVATE);
+    void *memory = mmap(NULL, count * size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (memory == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    return memory;
+}
+
+// Maps the binary file at path as *count elements of size bytes each
+// The pages are faulted in up front, so the timed region never waits on the
+// load, and advised for a sequential scan. The mapping is MAP_SHARED: forked
+// children use the same page cache pages without a copy, and a writable
+// mapping stores straight into the file.
+static inline void *map_file(const char *path, size_t size, size_t *count, int writable) {
+    int fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        exit(1);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0 || info.st_size % size != 0) {
+        fprintf(stderr, "%s: not a positive whole number of %zu byte elements\n", path, size);
+        exit(1);
+    }
+    *count = info.st_size / size;
+    void *memory = mmap(NULL, info.st_size, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED | MAP_POPULATE,
+                        fd, 0);
+    if (memory == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    close(fd);
+
+    // Huge pages only take on file systems that support them
+    madvise(memory, info.st_size, MADV_SEQUENTIAL);
+    madvise(memory, info.st_size, MADV_HUGEPAGE);
+    return memory;
+}
+
+#endif
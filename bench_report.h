@@ -0,0 +1,419 @@
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+// Repetition statistics and the report printed at the end of every program
+// Each config runs opts.warmups untimed times, then opts.reps timed times, and
+// the timed samples are reduced to min / median / p95 / mean / stddev.
+// Throughput counts every input element (and its bytes) once per run, so sorts
+// and scans of the same array are directly comparable. Counters, heap bytes and
+// page faults are averaged per run; memory sizes are the largest seen in any timed run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include "elem_type.h"
+#include "bench_options.h"
+#include "perf_counters.h"
+#include "mem_profile.h"
+#include "numa_placement.h"
+
+// Everything measured over one phase of a run
+typedef struct {
+    PerfSample perf;            // Counter totals of all workers (-p)
+    long long alloc_bytes;      // Heap bytes allocated
+    long long faults;           // Page faults taken (getrusage, always counted)
+} PhaseStats;
+
+// Written into shared memory by the worker process that ran one map task
+typedef struct {
+    PhaseStats map;             // The task's part of the map phase
+    MemUsage mem;
+} ChildReport;
+
+static long long child_fault_mark;  // page_faults() of the worker process at child_report_begin()
+
+// Starts measuring a task in a worker process, returns the mark to end it with
+static inline long long child_report_begin(void) {
+    reset_peak_rss();
+    child_fault_mark = page_faults();
+    return heap_allocated_bytes();
+}
+
+// Fills report with the heap bytes the task allocated, the faults it took and
+// the worker's memory; its counters are read by the parent through the
+// worker's pid
+static inline void child_report_end(ChildReport *report, long long heap_mark, int detailed) {
+    perf_clear(&report->map.perf);
+    report->map.alloc_bytes = heap_allocated_bytes() - heap_mark;
+    report->map.faults = page_faults() - child_fault_mark;
+    read_mem_usage(&report->mem, detailed);
+}
+
+// Map-phase time a worker spent on its own slice, for per-node bandwidth (-a)
+typedef struct {
+    _Alignas(64) double seconds;
+    size_t bytes;
+} SliceTiming;
+
+// Statistics of one worker-count config
+typedef struct {
+    int workers;
+    int threads;                // Threads per worker process, 0 unless hybrid
+    double min;                 // Seconds, over the timed repetitions
+    double median;
+    double p95;
+    double mean;
+    double stddev;
+    double elems_per_sec;       // From the median
+    double gb_per_sec;
+    PhaseStats map;
+    PhaseStats reduce;
+    long peak_rss_kb;           // VmHWM of the program itself (the parent for processes)
+    int children;               // Forked children per run, 0 for threads
+    long child_peak_kb;         // Largest VmHWM of a single child
+    long child_pss_kb;          // Sum of child PSS, which counts shared pages once (-m)
+    long child_uss_kb;          // Sum of child USS, memory private to the children (-m)
+    int nodes;                  // Entries of node_gb_per_sec, 0 unless affinity mode (-a)
+    double node_gb_per_sec[MAX_NODES];  // Slice bytes of a node / its slowest slice
+} BenchResult;
+
+static inline void phase_clear(PhaseStats *phase) {
+    perf_clear(&phase->perf);
+    phase->alloc_bytes = 0;
+    phase->faults = 0;
+}
+
+static inline void phase_add(PhaseStats *total, const PhaseStats *phase) {
+    perf_add(&total->perf, &phase->perf);
+    total->alloc_bytes += phase->alloc_bytes;
+    total->faults += phase->faults;
+}
+
+static long long phase_alloc_mark;  // heap_allocated_bytes() at the previous mark
+static long long phase_fault_mark;  // page_faults() at the previous mark
+
+// Ends the phase running since the previous mark: adds the counters of the
+// first n threads of perf, the heap bytes allocated and the page faults taken
+// meanwhile to phase. A NULL phase only starts the next one.
+static inline void phase_mark(PerfSet *perf, int n, PhaseStats *phase) {
+    perf_set_mark(perf, n, (phase != NULL) ? &phase->perf : NULL);
+    long long allocated = heap_allocated_bytes();
+    long long faults = page_faults();
+    if (phase != NULL) {
+        phase->alloc_bytes += allocated - phase_alloc_mark;
+        phase->faults += faults - phase_fault_mark;
+    }
+    phase_alloc_mark = allocated;
+    phase_fault_mark = faults;
+}
+
+// Resets result before the runs of a config with workers workers
+static inline void begin_result(BenchResult *result, int workers, int children) {
+    memset(result, 0, sizeof(*result));
+    result->workers = workers;
+    result->children = children;
+    result->child_peak_kb = -1;
+    result->child_pss_kb = -1;
+    result->child_uss_kb = -1;
+}
+
+// Folds the parent's peak and the children's reports of one timed run into result
+static inline void record_run(BenchResult *result, long peak_rss_kb, const ChildReport *reports) {
+    if (peak_rss_kb > result->peak_rss_kb) {
+        result->peak_rss_kb = peak_rss_kb;
+    }
+    long pss = 0, uss = 0;
+    for (int i = 0; i < result->children; i++) {
+        phase_add(&result->map, &reports[i].map);
+        if (reports[i].mem.peak_rss_kb > result->child_peak_kb) {
+            result->child_peak_kb = reports[i].mem.peak_rss_kb;
+        }
+        pss = (pss < 0 || reports[i].mem.pss_kb < 0) ? -1 : pss + reports[i].mem.pss_kb;
+        uss = (uss < 0 || reports[i].mem.uss_kb < 0) ? -1 : uss + reports[i].mem.uss_kb;
+    }
+    if (result->children > 0 && pss > result->child_pss_kb) {
+        result->child_pss_kb = pss;
+    }
+    if (result->children > 0 && uss > result->child_uss_kb) {
+        result->child_uss_kb = uss;
+    }
+}
+
+static inline int compare_seconds(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Median of count samples, sorting them in place
+static inline double median_seconds(double *samples, int count) {
+    qsort(samples, count, sizeof(double), compare_seconds);
+    return (count % 2) ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+}
+
+// Adds the per-node bandwidth of one timed run of n pinned slices to result
+// A node's slices run side by side, so its bandwidth is their bytes over the
+// time of the slowest one
+static inline void record_slices(BenchResult *result, const SliceTiming *timings, int n) {
+    result->nodes = placement.nodes;
+    for (int node = 0; node < placement.nodes; node++) {
+        double bytes = 0, seconds = 0;
+        for (int w = 0; w < n; w++) {
+            if (worker_node(w) == node) {
+                bytes += timings[w].bytes;
+                seconds = (timings[w].seconds > seconds) ? timings[w].seconds : seconds;
+            }
+        }
+        if (seconds > 0) {
+            result->node_gb_per_sec[node] += bytes / seconds / 1e9;
+        }
+    }
+}
+
+// Reduces reps timed samples of a run over n elements, sorting samples in place,
+// and turns the phase totals of all reps into per-run averages
+static inline void summarize_samples(double *samples, int reps, size_t n, BenchResult *result) {
+    result->median = median_seconds(samples, reps);
+    result->min = samples[0];
+    result->p95 = samples[(95 * reps + 99) / 100 - 1];      // Nearest rank
+
+    double sum = 0;
+    for (int r = 0; r < reps; r++) {
+        sum += samples[r];
+    }
+    result->mean = sum / reps;
+    double squares = 0;
+    for (int r = 0; r < reps; r++) {
+        squares += (samples[r] - result->mean) * (samples[r] - result->mean);
+    }
+    result->stddev = (reps > 1) ? sqrt(squares / (reps - 1)) : 0;
+
+    result->elems_per_sec = n / result->median;
+    result->gb_per_sec = n * sizeof(elem_t) / result->median / 1e9;
+
+    perf_average(&result->map.perf, reps);
+    perf_average(&result->reduce.perf, reps);
+    result->map.alloc_bytes /= reps;
+    result->reduce.alloc_bytes /= reps;
+    result->map.faults /= reps;
+    result->reduce.faults /= reps;
+    for (int node = 0; node < result->nodes; node++) {
+        result->node_gb_per_sec[node] /= reps;
+    }
+}
+
+// Prints counter e of sample, or fallback if it was not counted
+static inline void print_count(FILE *out, const PerfSample *sample, int e, const char *format, const char *fallback) {
+    if (sample->available & (1u << e)) {
+        fprintf(out, format, sample->count[e]);
+    } else {
+        fprintf(out, "%s", fallback);
+    }
+}
+
+// Prints IPC of sample, or fallback if cycles or instructions were not counted
+static inline void print_ipc(FILE *out, const PerfSample *sample, const char *format, const char *fallback) {
+    double ipc = perf_ipc(sample);
+    if (ipc >= 0) {
+        fprintf(out, format, ipc);
+    } else {
+        fprintf(out, "%s", fallback);
+    }
+}
+
+// Prints a kB figure, or fallback if it is unavailable (-1)
+static inline void print_kb(FILE *out, long kb, const char *format, const char *fallback) {
+    if (kb >= 0) {
+        fprintf(out, format, kb);
+    } else {
+        fprintf(out, "%s", fallback);
+    }
+}
+
+// First column of the text tables: the worker count, or processes x threads
+// for a hybrid config
+static inline const char *config_label(const BenchResult *result, char *label, size_t size) {
+    if (result->threads > 0) {
+        snprintf(label, size, "%dx%d", result->workers, result->threads);
+    } else {
+        snprintf(label, size, "%d", result->workers);
+    }
+    return label;
+}
+
+// Input column of the reports: the distribution, or "file" for -i input
+static inline const char *input_label(const Options *opts) {
+    return (opts->input != NULL) ? "file" : distribution_names[opts->dist];
+}
+
+// Returns the stream the report is written to
+// For csv and json, stdout is kept for the report alone and everything the
+// program prints along the way moves to stderr
+static inline FILE *open_report(const Options *opts) {
+    if (opts->format == FORMAT_TEXT) {
+        return stdout;
+    }
+    fflush(stdout);
+    int fd = dup(STDOUT_FILENO);
+    FILE *report = (fd < 0) ? NULL : fdopen(fd, "w");
+    if (report == NULL) {
+        perror("report stream");
+        return stdout;
+    }
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    return report;
+}
+
+// Prints results of all configs in the format chosen with -f
+// workers_label names the first text table column, e.g. "Threads"; the csv
+// threads column and the json threads field are empty / null unless hybrid
+static inline void print_report(FILE *out, const Options *opts, const char *program, const char *mode,
+                                const char *workers_label, const BenchResult *results) {
+    char label[32];
+    if (opts->format == FORMAT_CSV) {
+        fprintf(out, "program,mode,type,dist,n,workers,threads,reps,warmups,min_s,median_s,p95_s,mean_s,stddev_s,"
+                     "elems_per_s,gb_per_s,peak_rss_kb,child_peak_kb,child_pss_kb,child_uss_kb,"
+                     "map_alloc_bytes,reduce_alloc_bytes,map_faults,reduce_faults,node_gb_per_s");
+        for (int phase = 0; phase < 2; phase++) {
+            const char *name = phase ? "reduce" : "map";
+            fprintf(out, ",%s_ipc", name);
+            for (int e = 0; e < PERF_EVENTS; e++) {
+                fprintf(out, ",%s_%s", name, perf_event_names[e]);
+            }
+        }
+        fprintf(out, "\n");
+        for (int c = 0; c < opts->num_configs; c++) {
+            const BenchResult *r = &results[c];
+            fprintf(out, "%s,%s,%s,%s,%zu,%d,", program, mode, ELEM_NAME, input_label(opts), opts->n, r->workers);
+            if (r->threads > 0) {
+                fprintf(out, "%d", r->threads);
+            }
+            fprintf(out, ",%d,%d,%.9f,%.9f,%.9f,%.9f,%.9f,%.6e,%.6f,%ld", opts->reps, opts->warmups, r->min, r->median, r->p95, r->mean, r->stddev, r->elems_per_sec, r->gb_per_sec, r->peak_rss_kb);
+            print_kb(out, r->child_peak_kb, ",%ld", ",");
+            print_kb(out, r->child_pss_kb, ",%ld", ",");
+            print_kb(out, r->child_uss_kb, ",%ld", ",");
+            fprintf(out, ",%lld,%lld,%lld,%lld,", r->map.alloc_bytes, r->reduce.alloc_bytes, r->map.faults,
+                    r->reduce.faults);
+            for (int node = 0; node < r->nodes; node++) {
+                fprintf(out, "%s%d:%.3f", node ? ";" : "", node, r->node_gb_per_sec[node]);
+            }
+            for (int phase = 0; phase < 2; phase++) {
+                const PerfSample *sample = phase ? &r->reduce.perf : &r->map.perf;
+                print_ipc(out, sample, ",%.3f", ",");
+                for (int e = 0; e < PERF_EVENTS; e++) {
+                    print_count(out, sample, e, ",%lld", ",");
+                }
+            }
+            fprintf(out, "\n");
+        }
+    } else if (opts->format == FORMAT_JSON) {
+        fprintf(out, "{\"program\": \"%s\", \"mode\": \"%s\", \"type\": \"%s\", \"dist\": \"%s\", "
+                     "\"seed\": %llu, \"n\": %zu, \"reps\": %d, \"warmups\": %d, \"results\": [\n",
+                program, mode, ELEM_NAME, input_label(opts), (unsigned long long)opts->seed, opts->n, opts->reps, opts->warmups);
+        for (int c = 0; c < opts->num_configs; c++) {
+            const BenchResult *r = &results[c];
+            fprintf(out, "  {\"workers\": %d, \"threads\": ", r->workers);
+            if (r->threads > 0) {
+                fprintf(out, "%d", r->threads);
+            } else {
+                fprintf(out, "null");
+            }
+            fprintf(out, ", \"min_s\": %.9f, \"median_s\": %.9f, \"p95_s\": %.9f, "
+                         "\"mean_s\": %.9f, \"stddev_s\": %.9f, \"elems_per_s\": %.6e, \"gb_per_s\": %.6f, "
+                         "\"peak_rss_kb\": %ld",
+                    r->min, r->median, r->p95, r->mean, r->stddev, r->elems_per_sec, r->gb_per_sec, r->peak_rss_kb);
+            fprintf(out, ", \"child_peak_kb\": ");
+            print_kb(out, r->child_peak_kb, "%ld", "null");
+            fprintf(out, ", \"child_pss_kb\": ");
+            print_kb(out, r->child_pss_kb, "%ld", "null");
+            fprintf(out, ", \"child_uss_kb\": ");
+            print_kb(out, r->child_uss_kb, "%ld", "null");
+            fprintf(out, ", \"node_gb_per_s\": ");
+            for (int node = 0; node < r->nodes; node++) {
+                fprintf(out, "%s%.6f", node ? ", " : "[", r->node_gb_per_sec[node]);
+            }
+            fprintf(out, "%s", r->nodes ? "]" : "null");
+            for (int phase = 0; phase < 2; phase++) {
+                const PhaseStats *stats = phase ? &r->reduce : &r->map;
+                const PerfSample *sample = &stats->perf;
+                fprintf(out, ", \"%s\": {\"alloc_bytes\": %lld, \"faults\": %lld, \"ipc\": ",
+                        phase ? "reduce" : "map", stats->alloc_bytes, stats->faults);
+                print_ipc(out, sample, "%.3f", "null");
+                for (int e = 0; e < PERF_EVENTS; e++) {
+                    fprintf(out, ", \"%s\": ", perf_event_names[e]);
+                    print_count(out, sample, e, "%lld", "null");
+                }
+                fprintf(out, "}");
+            }
+            fprintf(out, "}%s\n", (c + 1 < opts->num_configs) ? "," : "");
+        }
+        fprintf(out, "]}\n");
+    } else {
+        fprintf(out, "\nPerformance Summary (%d runs after %d warmup):\n", opts->reps, opts->warmups);
+        fprintf(out, "%-10s %-12s %-12s %-12s %-12s %-10s\n",
+                workers_label, "Median (s)", "P95 (s)", "Stddev (s)", "Melem/s", "GB/s");
+        for (int c = 0; c < opts->num_configs; c++) {
+            const BenchResult *r = &results[c];
+            fprintf(out, "%-10s %-12.6f %-12.6f %-12.6f %-12.2f %-10.3f\n",
+                    config_label(r, label, sizeof(label)), r->median, r->p95, r->stddev, r->elems_per_sec / 1e6, r->gb_per_sec);
+        }
+
+        fprintf(out, "\nMemory (peaks over runs, heap bytes and page faults per run; - = not measured):\n");
+        fprintf(out, "%-10s %-14s %-16s %-16s %-12s %-14s %-14s %-14s %s\n", workers_label, "Peak RSS (KB)",
+                "Map alloc (B)", "Reduce alloc (B)", "Map faults", "Reduce faults", "Child peak (KB)",
+                "Child PSS (KB)", "Child USS (KB)");
+        for (int c = 0; c < opts->num_configs; c++) {
+            const BenchResult *r = &results[c];
+            fprintf(out, "%-10s %-14ld %-16lld %-16lld %-12lld %-14lld ", config_label(r, label, sizeof(label)),
+                    r->peak_rss_kb, r->map.alloc_bytes, r->reduce.alloc_bytes, r->map.faults, r->reduce.faults);
+            print_kb(out, r->child_peak_kb, "%-15ld ", "-               ");
+            print_kb(out, r->child_pss_kb, "%-14ld ", "-              ");
+            print_kb(out, r->child_uss_kb, "%ld", "-");
+            fprintf(out, "\n");
+        }
+
+        if (opts->affinity) {
+            fprintf(out, "\nPer-node bandwidth (GB/s, bytes of a node's slices over its slowest slice):\n");
+            fprintf(out, "%-10s", workers_label);
+            for (int node = 0; node < placement.nodes; node++) {
+                fprintf(out, " Node %-7d", node);
+            }
+            fprintf(out, "\n");
+            for (int c = 0; c < opts->num_configs; c++) {
+                fprintf(out, "%-10s", config_label(&results[c], label, sizeof(label)));
+                for (int node = 0; node < results[c].nodes; node++) {
+                    if (results[c].node_gb_per_sec[node] > 0) {
+                        fprintf(out, " %-12.3f", results[c].node_gb_per_sec[node]);
+                    } else {
+                        fprintf(out, " %-12s", "-");
+                    }
+                }
+                fprintf(out, "\n");
+            }
+        }
+
+        if (opts->perf) {
+            fprintf(out, "\nCounters (all workers, per run; - = not available):\n");
+            fprintf(out, "%-10s %-7s %-14s %-14s %-6s %-12s %-12s %-10s %s\n", workers_label, "Phase",
+                    "Cycles", "Instructions", "IPC", "LLC misses", "Br misses", "Ctx sw", "Page faults");
+            for (int c = 0; c < opts->num_configs; c++) {
+                for (int phase = 0; phase < 2; phase++) {
+                    const PerfSample *sample = phase ? &results[c].reduce.perf : &results[c].map.perf;
+                    fprintf(out, "%-10s %-7s ", config_label(&results[c], label, sizeof(label)), phase ? "reduce" : "map");
+                    print_count(out, sample, PERF_CYCLES, "%-14lld ", "-              ");
+                    print_count(out, sample, PERF_INSTRUCTIONS, "%-14lld ", "-              ");
+                    print_ipc(out, sample, "%-6.2f ", "-      ");
+                    print_count(out, sample, PERF_LLC_MISSES, "%-12lld ", "-            ");
+                    print_count(out, sample, PERF_BRANCH_MISSES, "%-12lld ", "-            ");
+                    print_count(out, sample, PERF_CONTEXT_SWITCHES, "%-10lld ", "-          ");
+                    print_count(out, sample, PERF_PAGE_FAULTS, "%lld", "-");
+                    fprintf(out, "\n");
+                }
+            }
+        }
+    }
+    fflush(out);
+}
+
+#endif
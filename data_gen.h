@@ -0,0 +1,101 @@
+#ifndef DATA_GEN_H
+#define DATA_GEN_H
+
+// Deterministic input generation shared by all programs
+// Element i is a pure function of (seed, i, distribution): a SplitMix64 hash of
+// the counter replaces srand / rand, so any split of the array over workers
+// fills it in parallel with bit-identical contents.
+//   uniform       0..99, the original rand() % 100 range (default)
+//   full          any value of the element type (finite for float / double)
+//   sorted        0, 1, 2, ...
+//   reverse       n-1, n-2, ..., 0
+//   few-unique    16 distinct values
+//   zipf          0..999, value k drawn with probability ~ 1 / (k + 1)
+//   organ-pipe    ascending to the middle, then descending
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "elem_type.h"
+
+#define DEFAULT_SEED 42
+#define UNIFORM_RANGE 100
+#define FEW_UNIQUE_VALUES 16
+#define ZIPF_VALUES 1000
+
+// Distributions
+#define DIST_UNIFORM 0
+#define DIST_FULL 1
+#define DIST_SORTED 2
+#define DIST_REVERSE 3
+#define DIST_FEW_UNIQUE 4
+#define DIST_ZIPF 5
+#define DIST_ORGAN_PIPE 6
+#define DISTRIBUTIONS 7
+
+static const char *const distribution_names[DISTRIBUTIONS] = {
+    "uniform", "full", "sorted", "reverse", "few-unique", "zipf", "organ-pipe"
+};
+
+// Returns DIST_* for name, -1 if unknown
+static inline int parse_distribution(const char *name) {
+    for (int d = 0; d < DISTRIBUTIONS; d++) {
+        if (strcmp(name, distribution_names[d]) == 0) {
+            return d;
+        }
+    }
+    return -1;
+}
+
+// SplitMix64 finalizer: a bijective mix of x
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Random 64 bits for counter i of stream seed
+static inline uint64_t counter_random(uint64_t seed, uint64_t i) {
+    return mix64(seed * 0x9E3779B97F4A7C15ull + i * 0xD1B54A32D192ED03ull + 1);
+}
+
+// Element i of an n element array
+static inline elem_t generate_element(int dist, uint64_t seed, size_t i, size_t n) {
+    uint64_t bits = counter_random(seed, i);
+    if (dist == DIST_FULL) {
+        elem_t x = key_to_elem(bits >> (64 - ELEM_BITS));
+#if !ELEM_IS_INTEGER
+        // Rehash the rare NaN / infinity bit patterns
+        while (!isfinite(x)) {
+            bits = mix64(bits);
+            x = key_to_elem(bits >> (64 - ELEM_BITS));
+        }
+#endif
+        return x;
+    } else if (dist == DIST_SORTED) {
+        return (elem_t)i;
+    } else if (dist == DIST_REVERSE) {
+        return (elem_t)(n - 1 - i);
+    } else if (dist == DIST_FEW_UNIQUE) {
+        return (elem_t)(bits % FEW_UNIQUE_VALUES);
+    } else if (dist == DIST_ZIPF) {
+        // Inverse CDF of the continuous 1 / x law: floor((K + 1)^u) - 1
+        double u = (bits >> 11) * 0x1.0p-53;
+        long k = (long)pow(ZIPF_VALUES + 1, u) - 1;
+        return (elem_t)((k < ZIPF_VALUES) ? k : ZIPF_VALUES - 1);
+    } else if (dist == DIST_ORGAN_PIPE) {
+        return (elem_t)((i < n / 2) ? i : n - 1 - i);
+    }
+    return (elem_t)(bits % UNIFORM_RANGE);
+}
+
+// Fills array[start..end) of an n element array
+static inline void generate_range(elem_t *array, size_t start, size_t end, size_t n, int dist, uint64_t seed) {
+    for (size_t i = start; i < end; i++) {
+        array[i] = generate_element(dist, seed, i, n);
+    }
+}
+
+#endif
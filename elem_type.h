@@ -0,0 +1,116 @@
+#ifndef ELEM_TYPE_H
+#define ELEM_TYPE_H
+
+// Element type shared by all programs, chosen at compile time so every kernel
+// is specialized for it:
+//   (default)      int32      -DELEM_INT64   int64     -DELEM_UINT64  uint64
+//   -DELEM_FLOAT   float      -DELEM_DOUBLE  double
+// bench.sh builds one binary per type.
+//
+// elem_to_key() maps an element to unsigned bits that sort in the same order,
+// used by the radix sort and the lock-free reduce.
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(ELEM_INT64)
+typedef int64_t elem_t;
+typedef long long sum_t;
+#define ELEM_NAME "int64"
+#define ELEM_LOWEST INT64_MIN
+#define ELEM_HIGHEST INT64_MAX
+#define ELEM_BITS 64
+#define ELEM_IS_INTEGER 1
+#define ELEM_FMT "%lld"
+#define ELEM_PRINT(x) ((long long)(x))
+#define SUM_FMT "%lld"
+#elif defined(ELEM_UINT64)
+typedef uint64_t elem_t;
+typedef unsigned long long sum_t;
+#define ELEM_NAME "uint64"
+#define ELEM_LOWEST 0
+#define ELEM_HIGHEST UINT64_MAX
+#define ELEM_BITS 64
+#define ELEM_IS_INTEGER 1
+#define ELEM_FMT "%llu"
+#define ELEM_PRINT(x) ((unsigned long long)(x))
+#define SUM_FMT "%llu"
+#elif defined(ELEM_FLOAT)
+typedef float elem_t;
+typedef double sum_t;
+#define ELEM_NAME "float"
+#define ELEM_LOWEST (-INFINITY)
+#define ELEM_HIGHEST INFINITY
+#define ELEM_BITS 32
+#define ELEM_IS_INTEGER 0
+#define ELEM_FMT "%g"
+#define ELEM_PRINT(x) ((double)(x))
+#define SUM_FMT "%.17g"
+#elif defined(ELEM_DOUBLE)
+typedef double elem_t;
+typedef double sum_t;
+#define ELEM_NAME "double"
+#define ELEM_LOWEST (-INFINITY)
+#define ELEM_HIGHEST INFINITY
+#define ELEM_BITS 64
+#define ELEM_IS_INTEGER 0
+#define ELEM_FMT "%g"
+#define ELEM_PRINT(x) ((double)(x))
+#define SUM_FMT "%.17g"
+#else
+#define ELEM_INT32 1
+typedef int32_t elem_t;
+typedef long long sum_t;
+#define ELEM_NAME "int32"
+#define ELEM_LOWEST INT32_MIN
+#define ELEM_HIGHEST INT32_MAX
+#define ELEM_BITS 32
+#define ELEM_IS_INTEGER 1
+#define ELEM_FMT "%d"
+#define ELEM_PRINT(x) ((int)(x))
+#define SUM_FMT "%lld"
+#endif
+
+// Order-preserving unsigned key of an element
+static inline uint64_t elem_to_key(elem_t x) {
+#if defined(ELEM_INT64)
+    return (uint64_t)x ^ 0x8000000000000000ull;
+#elif defined(ELEM_UINT64)
+    return x;
+#elif defined(ELEM_FLOAT)
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+#elif defined(ELEM_DOUBLE)
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return (bits & 0x8000000000000000ull) ? ~bits : (bits | 0x8000000000000000ull);
+#else
+    return (uint32_t)x ^ 0x80000000u;
+#endif
+}
+
+// Inverse of elem_to_key()
+static inline elem_t key_to_elem(uint64_t key) {
+#if defined(ELEM_INT64)
+    return (elem_t)(key ^ 0x8000000000000000ull);
+#elif defined(ELEM_UINT64)
+    return key;
+#elif defined(ELEM_FLOAT)
+    uint32_t bits = (uint32_t)key;
+    bits = (bits & 0x80000000u) ? (bits & 0x7FFFFFFFu) : ~bits;
+    elem_t x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+#elif defined(ELEM_DOUBLE)
+    uint64_t bits = (key & 0x8000000000000000ull) ? (key & 0x7FFFFFFFFFFFFFFFull) : ~key;
+    elem_t x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+#else
+    return (elem_t)((uint32_t)key ^ 0x80000000u);
+#endif
+}
+
+#endif
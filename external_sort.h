@@ -0,0 +1,466 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+// Out-of-core sort of a binary file of elem_t, for inputs larger than memory
+//  - Run formation: a reader thread fills run buffers from the input, the
+//    caller sorts each one in memory and a writer thread appends it to a spill
+//    file. With three buffers, reading run i+1 and writing run i-1 overlap the
+//    sort of run i, so the disk and the CPUs stay busy together.
+//  - Merge: a loser tree over all runs streams the spill file into the output.
+//    The run buffers are reused as one large sequential read buffer per run
+//    plus two output buffers, which the writer thread flushes while the tree
+//    fills the other one.
+// Memory is the three run buffers, carved by the caller from its arena (so -H
+// applies to them), whatever sort_run() needs as scratch and nothing that
+// grows with the file. Direct I/O (O_DIRECT) bypasses the page
+// cache; every buffer, length and offset is then a multiple of EXT_ALIGN,
+// except the tail of a file, which is written after switching O_DIRECT off.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "elem_type.h"
+#include "arena.h"
+#include "loser_tree.h"
+
+// <fcntl.h> names O_DIRECT only under _GNU_SOURCE; glibc defines the value regardless
+#ifndef O_DIRECT
+#define O_DIRECT __O_DIRECT
+#endif
+
+#define EXT_BUFFERS 3                   // Run buffers: one reading, one sorting, one writing
+#define EXT_ALIGN 4096                  // O_DIRECT address, length and offset granularity
+#define EXT_MIN_MERGE_BUFFER (1 << 20)  // Smaller read buffers per run turn the merge seek bound
+
+// Sorts run[0..n) in memory
+typedef void (*ext_sort_fn)(elem_t *run, size_t n, void *arg);
+
+// Buffer indices handed between pipeline stages; index -1 ends the stream
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int index[EXT_BUFFERS + 1];
+    size_t count[EXT_BUFFERS + 1];  // Elements held by the buffer
+    int head;
+    int size;
+} BufferQueue;
+
+// Reader or writer thread moving whole buffers between a file and memory
+typedef struct {
+    int fd;
+    elem_t *base;                   // Buffer i starts at base + i * capacity
+    size_t capacity;                // Elements per buffer
+    BufferQueue *todo;              // Buffers to fill / to write out
+    BufferQueue *done;              // Where they go next
+    pthread_t thread;
+} IoStage;
+
+typedef struct {
+    int input;                      // Unsorted elements
+    int output;                     // Sorted elements
+    int spill;                      // Unlinked temp file holding the sorted runs
+    int direct;                     // Files use O_DIRECT
+    size_t n;                       // Elements in input
+    size_t run_elems;               // Elements per run, a multiple of EXT_ALIGN bytes
+    int runs;
+    size_t piece;                   // Elements per merge buffer
+    elem_t *memory;                 // EXT_BUFFERS run buffers, carved up again by the merge (caller's)
+} ExtSort;
+
+static inline void queue_init(BufferQueue *queue) {
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->head = 0;
+    queue->size = 0;
+}
+
+static inline void queue_destroy(BufferQueue *queue) {
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->changed);
+}
+
+static inline void queue_push(BufferQueue *queue, int index, size_t count) {
+    pthread_mutex_lock(&queue->lock);
+    int slot = (queue->head + queue->size++) % (EXT_BUFFERS + 1);
+    queue->index[slot] = index;
+    queue->count[slot] = count;
+    pthread_cond_signal(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Waits for the next buffer, returns its index and element count
+static inline int queue_pop(BufferQueue *queue, size_t *count) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->size == 0) {
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    int index = queue->index[queue->head];
+    *count = queue->count[queue->head];
+    queue->head = (queue->head + 1) % (EXT_BUFFERS + 1);
+    queue->size--;
+    pthread_mutex_unlock(&queue->lock);
+    return index;
+}
+
+// Turns O_DIRECT on or off for fd; a file system without it stays buffered
+static inline void set_direct(int fd, int direct) {
+    int flags = fcntl(fd, F_GETFL);
+    int wanted = direct ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+    static int warned = 0;
+    if (wanted != flags && fcntl(fd, F_SETFL, wanted) != 0 && !warned) {
+        perror("O_DIRECT");
+        warned = 1;
+    }
+}
+
+// Reads up to bytes at the file position, short only at end of file
+static inline size_t read_fully(int fd, void *buffer, size_t bytes) {
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t got = read(fd, (char *)buffer + done, bytes - done);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            perror("read");
+            exit(1);
+        }
+        if (got == 0) {
+            break;
+        }
+        done += got;
+    }
+    return done;
+}
+
+// Like read_fully() at offset, without moving the file position
+static inline size_t pread_fully(int fd, void *buffer, size_t bytes, off_t offset) {
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t got = pread(fd, (char *)buffer + done, bytes - done, offset + done);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            perror("pread");
+            exit(1);
+        }
+        if (got == 0) {
+            break;
+        }
+        done += got;
+    }
+    return done;
+}
+
+// Writes bytes at the file position; a tail that O_DIRECT cannot take is
+// written buffered, which is fine as it ends the file
+static inline void write_fully(int fd, const void *buffer, size_t bytes) {
+    if (bytes % EXT_ALIGN != 0) {
+        set_direct(fd, 0);
+    }
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t put = write(fd, (const char *)buffer + done, bytes - done);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put < 0) {
+            perror("write");
+            exit(1);
+        }
+        done += put;
+    }
+}
+
+// Reader thread: fills free buffers with consecutive runs until end of file
+static inline void *reader_stage(void *arg) {
+    IoStage *stage = arg;
+    while (1) {
+        size_t unused;
+        int index = queue_pop(stage->todo, &unused);
+        size_t bytes = read_fully(stage->fd, stage->base + index * stage->capacity, stage->capacity * sizeof(elem_t));
+        if (bytes == 0) {
+            queue_push(stage->done, -1, 0);
+            return NULL;
+        }
+        queue_push(stage->done, index, bytes / sizeof(elem_t));
+    }
+}
+
+// Writer thread: appends buffers to the file and recycles them until index -1
+static inline void *writer_stage(void *arg) {
+    IoStage *stage = arg;
+    while (1) {
+        size_t count;
+        int index = queue_pop(stage->todo, &count);
+        if (index < 0) {
+            return NULL;
+        }
+        write_fully(stage->fd, stage->base + index * stage->capacity, count * sizeof(elem_t));
+        queue_push(stage->done, index, 0);
+    }
+}
+
+// Opens path with flags and mode, exits on failure
+static inline int open_or_die(const char *path, int flags) {
+    int fd = open(path, flags, 0644);
+    if (fd < 0) {
+        perror(path);
+        exit(1);
+    }
+    return fd;
+}
+
+// Opens input for sorting into output, spilling runs of about run_elems to
+// an unlinked file in tmpdir; returns 0 on success
+static inline int ext_sort_open(ExtSort *sort, const char *input, const char *output, const char *tmpdir,
+                                size_t run_elems, int direct) {
+    sort->input = open_or_die(input, O_RDONLY);
+    struct stat info;
+    if (fstat(sort->input, &info) != 0) {
+        perror(input);
+        close(sort->input);
+        return 1;
+    }
+    if (info.st_size == 0 || info.st_size % sizeof(elem_t) != 0) {
+        fprintf(stderr, "%s: %lld bytes is not a positive whole number of %s elements\n",
+                input, (long long)info.st_size, ELEM_NAME);
+        close(sort->input);
+        return 1;
+    }
+    sort->n = info.st_size / sizeof(elem_t);
+
+    // Truncating the output only once it is known not to be the input, which
+    // would otherwise be emptied before a single run is read
+    sort->output = open_or_die(output, O_RDWR | O_CREAT);
+    struct stat out_info;
+    if (fstat(sort->output, &out_info) != 0) {
+        perror(output);
+        close(sort->input);
+        close(sort->output);
+        return 1;
+    }
+    if (out_info.st_dev == info.st_dev && out_info.st_ino == info.st_ino) {
+        fprintf(stderr, "%s: output must be a different file than the input\n", output);
+        close(sort->input);
+        close(sort->output);
+        return 1;
+    }
+    if (ftruncate(sort->output, 0) != 0) {
+        perror(output);
+        exit(1);
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/extsort.XXXXXX", tmpdir);
+    sort->spill = mkstemp(path);
+    if (sort->spill < 0) {
+        perror(path);
+        exit(1);
+    }
+    unlink(path);
+
+    // Whole EXT_ALIGN blocks per run, and no more than the input needs
+    size_t block = EXT_ALIGN / sizeof(elem_t);
+    if (run_elems > sort->n) {
+        run_elems = sort->n;
+    }
+    sort->run_elems = (run_elems + block - 1) / block * block;
+    sort->runs = (int)((sort->n + sort->run_elems - 1) / sort->run_elems);
+    sort->direct = direct;
+
+    // The merge splits the run memory into one read buffer per run and two
+    // output buffers
+    sort->piece = EXT_BUFFERS * sort->run_elems / (sort->runs + 2) / block * block;
+    if (sort->piece == 0) {
+        fprintf(stderr, "%d runs do not fit the merge buffers; raise the run size\n", sort->runs);
+        close(sort->input);
+        close(sort->output);
+        close(sort->spill);
+        return 1;
+    }
+    if (sort->runs > 1 && sort->piece * sizeof(elem_t) < EXT_MIN_MERGE_BUFFER) {
+        fprintf(stderr, "Note: %zu KB read buffer per run over %d runs; a larger run size merges faster\n",
+                sort->piece * sizeof(elem_t) / 1024, sort->runs);
+    }
+    if (!direct) {
+        posix_fadvise(sort->input, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    sort->memory = NULL;
+    return 0;
+}
+
+// Bytes of the run buffers the caller sets sort->memory to after
+// ext_sort_open(); whole huge pages, so an arena block of this size starts on
+// a huge page boundary, which also meets O_DIRECT alignment
+static inline size_t ext_sort_memory_bytes(const ExtSort *sort) {
+    size_t bytes = EXT_BUFFERS * sort->run_elems * sizeof(elem_t);
+    return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+static inline void ext_sort_close(ExtSort *sort) {
+    close(sort->input);
+    close(sort->output);
+    close(sort->spill);
+}
+
+// Run formation: reads, sorts and spills every run, returns the run count
+// A single run is the whole answer and goes straight to the output
+static inline int ext_sort_runs(ExtSort *sort, ext_sort_fn sort_run, void *arg) {
+    int target = (sort->runs == 1) ? sort->output : sort->spill;
+    lseek(sort->input, 0, SEEK_SET);
+    lseek(target, 0, SEEK_SET);
+    if (ftruncate(sort->output, 0) != 0) {
+        perror("ftruncate");
+        exit(1);
+    }
+    set_direct(sort->input, sort->direct);
+    set_direct(target, sort->direct);
+
+    BufferQueue free_buffers, filled, sorted;
+    queue_init(&free_buffers);
+    queue_init(&filled);
+    queue_init(&sorted);
+    for (int i = 0; i < EXT_BUFFERS; i++) {
+        queue_push(&free_buffers, i, 0);
+    }
+    IoStage reader = {sort->input, sort->memory, sort->run_elems, &free_buffers, &filled, 0};
+    IoStage writer = {target, sort->memory, sort->run_elems, &sorted, &free_buffers, 0};
+    pthread_create(&reader.thread, NULL, reader_stage, &reader);
+    pthread_create(&writer.thread, NULL, writer_stage, &writer);
+
+    while (1) {
+        size_t count;
+        int index = queue_pop(&filled, &count);
+        if (index < 0) {
+            break;
+        }
+        sort_run(sort->memory + index * sort->run_elems, count, arg);
+        queue_push(&sorted, index, count);
+    }
+    queue_push(&sorted, -1, 0);
+
+    pthread_join(reader.thread, NULL);
+    pthread_join(writer.thread, NULL);
+    queue_destroy(&free_buffers);
+    queue_destroy(&filled);
+    queue_destroy(&sorted);
+    return sort->runs;
+}
+
+// Read position of one run during the merge
+typedef struct {
+    off_t next;                     // File offset of the next unread byte
+    off_t end;                      // File offset past the run
+    elem_t *buffer;
+    size_t pos;                     // Next element of buffer
+    size_t len;                     // Elements in buffer
+} RunCursor;
+
+// Loads the next piece of run into its buffer, returns 0 once it is used up
+static inline int run_refill(int fd, RunCursor *run, size_t capacity, int direct) {
+    if (run->next >= run->end) {
+        return 0;
+    }
+    size_t bytes = capacity * sizeof(elem_t);
+    if ((off_t)bytes > run->end - run->next) {
+        bytes = run->end - run->next;
+        if (direct) {
+            bytes = (bytes + EXT_ALIGN - 1) / EXT_ALIGN * EXT_ALIGN;
+        }
+    }
+    size_t got = pread_fully(fd, run->buffer, bytes, run->next);
+    if ((off_t)got > run->end - run->next) {
+        got = run->end - run->next;
+    }
+    if (got == 0) {
+        fprintf(stderr, "spill file ended early\n");
+        exit(1);
+    }
+    run->next += got;
+    run->pos = 0;
+    run->len = got / sizeof(elem_t);
+    if (!direct && run->next < run->end) {
+        posix_fadvise(fd, run->next, bytes, POSIX_FADV_WILLNEED);
+    }
+    return 1;
+}
+
+// Merge: streams the loser tree's output over all spilled runs into output
+static inline void ext_sort_merge(ExtSort *sort) {
+    if (sort->runs <= 1) {
+        return;
+    }
+
+    size_t piece = sort->piece;
+    lseek(sort->output, 0, SEEK_SET);
+    set_direct(sort->spill, sort->direct);
+    set_direct(sort->output, sort->direct);
+
+    RunCursor *cursors = malloc(sort->runs * sizeof(RunCursor));
+    LoserTree tree;
+    loser_tree_init(&tree, sort->runs);
+    for (int r = 0; r < sort->runs; r++) {
+        size_t first = (size_t)r * sort->run_elems;
+        size_t last = (first + sort->run_elems < sort->n) ? first + sort->run_elems : sort->n;
+        cursors[r] = (RunCursor){first * sizeof(elem_t), last * sizeof(elem_t), sort->memory + (2 + r) * piece, 0, 0};
+        if (run_refill(sort->spill, &cursors[r], piece, sort->direct)) {
+            loser_tree_set(&tree, r, cursors[r].buffer[0]);
+        }
+    }
+    loser_tree_build(&tree);
+
+    // Output buffers 0 and 1 alternate between the tree and the writer thread
+    BufferQueue free_buffers, full;
+    queue_init(&free_buffers);
+    queue_init(&full);
+    queue_push(&free_buffers, 1, 0);
+    IoStage writer = {sort->output, sort->memory, piece, &full, &free_buffers, 0};
+    pthread_create(&writer.thread, NULL, writer_stage, &writer);
+
+    int index = 0;
+    elem_t *out = sort->memory;
+    size_t count = 0;
+    while (loser_tree_live(&tree)) {
+        RunCursor *run = &cursors[tree.winner];
+        out[count++] = tree.head[tree.winner];
+        if (count == piece) {
+            queue_push(&full, index, count);
+            size_t unused;
+            index = queue_pop(&free_buffers, &unused);
+            out = sort->memory + index * piece;
+            count = 0;
+        }
+        if (++run->pos < run->len || run_refill(sort->spill, run, piece, sort->direct)) {
+            loser_tree_replace(&tree, run->buffer[run->pos]);
+        } else {
+            loser_tree_exhaust(&tree);
+        }
+    }
+    if (count > 0) {
+        queue_push(&full, index, count);
+    }
+    queue_push(&full, -1, 0);
+    pthread_join(writer.thread, NULL);
+
+    queue_destroy(&free_buffers);
+    queue_destroy(&full);
+    loser_tree_free(&tree);
+    free(cursors);
+}
+
+// Reads up to count elements from the start of path, returns how many
+static inline size_t read_elements(const char *path, elem_t *out, size_t count) {
+    int fd = open_or_die(path, O_RDONLY);
+    size_t got = pread_fully(fd, out, count * sizeof(elem_t), 0);
+    close(fd);
+    return got / sizeof(elem_t);
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef LOSER_TREE_H
+#define LOSER_TREE_H
+
+// Tournament tree of losers for merging K sorted sequences
+// Leaf i holds the current head of sequence i and every internal node keeps
+// the leaf that lost the match played there, so the overall winner sits on
+// top. When the winner's sequence advances only the log2(K) matches on its
+// path to the root are replayed, one comparison per level, against losers
+// that are already known. Exhausted leaves lose every match, so sequences may
+// end at different times; equal heads go to the lower leaf, keeping the merge
+// stable in sequence order.
+// multiway_split() finds where a given output rank cuts every sequence, so
+// workers can each merge their own slice of the output in one pass.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "elem_type.h"
+#include "arena.h"
+
+typedef struct {
+    int leaves;                     // Leaf slots, K rounded up to a power of 2
+    int winner;                     // Leaf with the smallest head
+    int *loser;                     // Loser of the match at internal node 1..leaves-1
+    elem_t *head;                   // Current element of each leaf
+    unsigned char *live;            // 0 once a leaf's sequence is exhausted
+} LoserTree;
+
+// Allocates a tree for k sequences, all exhausted until loser_tree_set()
+static inline void loser_tree_init(LoserTree *tree, int k) {
+    tree->leaves = 1;
+    while (tree->leaves < k) {
+        tree->leaves *= 2;
+    }
+    tree->winner = 0;
+    tree->loser = scratch_calloc(tree->leaves, sizeof(int));
+    tree->head = scratch_calloc(tree->leaves, sizeof(elem_t));
+    tree->live = scratch_calloc(tree->leaves, 1);
+}
+
+// Frees in reverse order of loser_tree_init(), as scratch_free() requires
+static inline void loser_tree_free(LoserTree *tree) {
+    scratch_free(tree->live);
+    scratch_free(tree->head);
+    scratch_free(tree->loser);
+}
+
+// Sets the first element of sequence i; call loser_tree_build() afterwards
+static inline void loser_tree_set(LoserTree *tree, int i, elem_t value) {
+    tree->head[i] = value;
+    tree->live[i] = 1;
+}
+
+// Whether leaf a wins its match against leaf b
+static inline int loser_tree_beats(const LoserTree *tree, int a, int b) {
+    if (!tree->live[b]) {
+        return 1;
+    }
+    if (!tree->live[a]) {
+        return 0;
+    }
+    return tree->head[a] < tree->head[b] || (!(tree->head[b] < tree->head[a]) && a < b);
+}
+
+// Plays the matches below node and returns the winner of its subtree
+static inline int loser_tree_play(LoserTree *tree, int node) {
+    if (node >= tree->leaves) {
+        return node - tree->leaves;
+    }
+    int a = loser_tree_play(tree, 2 * node);
+    int b = loser_tree_play(tree, 2 * node + 1);
+    if (loser_tree_beats(tree, a, b)) {
+        tree->loser[node] = b;
+        return a;
+    }
+    tree->loser[node] = a;
+    return b;
+}
+
+// Plays every match once the heads are set
+static inline void loser_tree_build(LoserTree *tree) {
+    tree->winner = loser_tree_play(tree, 1);
+}
+
+// Whether any sequence still has elements; the smallest is head[winner]
+static inline int loser_tree_live(const LoserTree *tree) {
+    return tree->live[tree->winner];
+}
+
+// Replays the matches from the winner's leaf to the root
+static inline void loser_tree_replay(LoserTree *tree) {
+    int winner = tree->winner;
+    for (int node = (winner + tree->leaves) / 2; node > 0; node /= 2) {
+        if (loser_tree_beats(tree, tree->loser[node], winner)) {
+            int loser = winner;
+            winner = tree->loser[node];
+            tree->loser[node] = loser;
+        }
+    }
+    tree->winner = winner;
+}
+
+// The winner's sequence moved on to value
+static inline void loser_tree_replace(LoserTree *tree, elem_t value) {
+    tree->head[tree->winner] = value;
+    loser_tree_replay(tree);
+}
+
+// The winner's sequence has no elements left
+static inline void loser_tree_exhaust(LoserTree *tree) {
+    tree->live[tree->winner] = 0;
+    loser_tree_replay(tree);
+}
+
+// ---- Multiway Merge ---------------------------------------------------------
+// Sequence j is src[bounds[j] .. bounds[j + 1]); keys come from elem_to_key(),
+// whose order matches elem_t's for every type
+
+// Elements of src[low..high) whose key is below key (less) or at most key
+static inline long count_keys_below(const elem_t *src, long low, long high, uint64_t key, int or_equal) {
+    long first = low;
+    while (low < high) {
+        long mid = low + (high - low) / 2;
+        uint64_t k = elem_to_key(src[mid]);
+        if (k < key || (or_equal && k == key)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low - first;
+}
+
+// Multi-sequence selection: split[j] is how many elements of sequence j come
+// before output rank rank in the stable merge of the k sequences
+// Bisects the key space for the smallest key with at least rank elements at
+// or below it, then hands out the tied elements in sequence order
+static inline void multiway_split(const elem_t *src, const long *bounds, int k, long rank, long *split) {
+    uint64_t low = UINT64_MAX;
+    uint64_t high = 0;
+    for (int j = 0; j < k; j++) {
+        if (bounds[j] < bounds[j + 1]) {
+            uint64_t first = elem_to_key(src[bounds[j]]);
+            uint64_t last = elem_to_key(src[bounds[j + 1] - 1]);
+            low = (first < low) ? first : low;
+            high = (last > high) ? last : high;
+        }
+    }
+    if (rank <= 0 || low > high) {
+        for (int j = 0; j < k; j++) {
+            split[j] = 0;
+        }
+        return;
+    }
+
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        long count = 0;
+        for (int j = 0; j < k; j++) {
+            count += count_keys_below(src, bounds[j], bounds[j + 1], mid, 1);
+        }
+        if (count >= rank) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    long remaining = rank;
+    for (int j = 0; j < k; j++) {
+        split[j] = count_keys_below(src, bounds[j], bounds[j + 1], low, 0);
+        remaining -= split[j];
+    }
+    for (int j = 0; j < k && remaining > 0; j++) {
+        long ties = count_keys_below(src, bounds[j], bounds[j + 1], low, 1) - split[j];
+        long take = (ties < remaining) ? ties : remaining;
+        split[j] += take;
+        remaining -= take;
+    }
+}
+
+// Merges src[bounds[j] + from[j] .. bounds[j] + to[j]) of every sequence j
+// into out through a loser tree, moving each element once
+static inline void multiway_merge(const elem_t *src, const long *bounds, int k, const long *from, const long *to,
+                                  elem_t *out) {
+    LoserTree tree;
+    loser_tree_init(&tree, k);
+    long *next = scratch_alloc(k * sizeof(long));
+    long *end = scratch_alloc(k * sizeof(long));
+    for (int j = 0; j < k; j++) {
+        next[j] = bounds[j] + from[j];
+        end[j] = bounds[j] + to[j];
+        if (next[j] < end[j]) {
+            loser_tree_set(&tree, j, src[next[j]]);
+        }
+    }
+    loser_tree_build(&tree);
+
+    long written = 0;
+    while (loser_tree_live(&tree)) {
+        int winner = tree.winner;
+        out[written++] = tree.head[winner];
+        if (++next[winner] < end[winner]) {
+            loser_tree_replace(&tree, src[next[winner]]);
+        } else {
+            loser_tree_exhaust(&tree);
+        }
+    }
+
+    scratch_free(end);
+    scratch_free(next);
+    loser_tree_free(&tree);
+}
+
+#endif
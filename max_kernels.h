@@ -0,0 +1,409 @@
+#ifndef MAX_KERNELS_H
+#define MAX_KERNELS_H
+
+// Chunk scan kernels shared by the max value programs
+// One pass over a chunk returns its max, min, sum and the index of the first max.
+// For int32 elements SIMD versions are picked at runtime with CPUID; the scalar
+// loop is the fallback and the kernel for every other element type.
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <stdint.h>
+#include "elem_type.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(ELEM_INT32)
+#include <immintrin.h>
+#define MAX_KERNELS_X86 1
+#endif
+
+#define SCAN_BLOCK (1 << 30)        // Kernels index in int lanes, scan_range() splits into blocks
+
+// Reduce Strategies
+#define REDUCE_LOCK 0       // Mutex / semaphore around combine_stats()
+#define REDUCE_SLOTS 1      // Per-worker padded slot, combined after join
+#define REDUCE_ATOMIC 2     // Lock-free CAS loops on shared atomics
+
+#define CACHE_LINE 64
+
+// The atomic reduce keeps max and argmax together with one 16-byte CAS, which
+// x86_64 has as cmpxchg16b; other targets would need libatomic or lack 128-bit
+// integers altogether (i386), so there the mode is rejected at parse time
+#if defined(__x86_64__)
+#define REDUCE_ATOMIC_AVAILABLE 1
+#endif
+
+// Result of scanning one chunk
+typedef struct {
+    elem_t max;
+    elem_t min;
+    sum_t sum;
+    size_t argmax;  // Index of first max, relative to the scanned data
+} ChunkStats;
+
+// Per-worker result slot, one cache line each so workers never share a line
+typedef struct {
+    _Alignas(CACHE_LINE) ChunkStats stats;
+} PaddedStats;
+
+// Folds other into stats, keeping the lowest index among equal maxima
+static inline void combine_stats(ChunkStats *stats, const ChunkStats *other) {
+    if (other->max > stats->max || (other->max == stats->max && other->argmax < stats->argmax)) {
+        stats->max = other->max;
+        stats->argmax = other->argmax;
+    }
+    if (other->min < stats->min) {
+        stats->min = other->min;
+    }
+    stats->sum += other->sum;
+}
+
+// Identity for combine_stats(), starting point of every reduce
+static inline ChunkStats empty_stats(void) {
+    ChunkStats stats = {ELEM_LOWEST, ELEM_HIGHEST, 0, SIZE_MAX};
+    return stats;
+}
+
+#ifdef REDUCE_ATOMIC_AVAILABLE
+// Lock-free global result
+// max and argmax are packed into one 128-bit key so a single CAS keeps them together
+typedef struct {
+    _Alignas(CACHE_LINE) unsigned __int128 max_key;
+    _Atomic uint64_t min_key;
+    _Atomic sum_t sum;
+} AtomicStats;
+
+// Packs max and argmax so that larger max, then smaller argmax, compares greater
+static inline unsigned __int128 pack_max_key(elem_t max, size_t argmax) {
+    return ((unsigned __int128)elem_to_key(max) << 64) | (uint64_t)~(uint64_t)argmax;
+}
+
+// 16-byte compare-and-swap, returns the value seen before the swap
+__attribute__((target("cx16")))
+static inline unsigned __int128 cas_u128(unsigned __int128 *p, unsigned __int128 expected, unsigned __int128 desired) {
+    return __sync_val_compare_and_swap(p, expected, desired);
+}
+
+// Resets atomic result before workers start
+static inline void reset_atomic_stats(AtomicStats *stats) {
+    stats->max_key = 0;
+    atomic_store(&stats->min_key, UINT64_MAX);
+    atomic_store(&stats->sum, 0);
+}
+
+// Folds other into the atomic result with CAS-max / CAS-min / CAS-add loops
+// Relaxed ordering is enough since join / waitpid publishes the result
+static inline void atomic_combine_stats(AtomicStats *stats, const ChunkStats *other) {
+    unsigned __int128 key = pack_max_key(other->max, other->argmax);
+    unsigned __int128 cur_key = cas_u128(&stats->max_key, 0, 0);
+    while (key > cur_key) {
+        unsigned __int128 seen = cas_u128(&stats->max_key, cur_key, key);
+        if (seen == cur_key) {
+            break;
+        }
+        cur_key = seen;
+    }
+
+    uint64_t min_key = elem_to_key(other->min);
+    uint64_t cur_min = atomic_load_explicit(&stats->min_key, memory_order_relaxed);
+    while (min_key < cur_min && !atomic_compare_exchange_weak_explicit(&stats->min_key, &cur_min, min_key,
+                                                                         memory_order_relaxed, memory_order_relaxed)) {
+    }
+
+    // CAS loop rather than fetch_add so floating point sums work too
+    sum_t cur_sum = atomic_load_explicit(&stats->sum, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&stats->sum, &cur_sum, cur_sum + other->sum,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Reads the atomic result back into a ChunkStats
+static inline ChunkStats load_atomic_stats(AtomicStats *stats) {
+    unsigned __int128 key = cas_u128(&stats->max_key, 0, 0);
+    ChunkStats result;
+    result.max = key_to_elem((uint64_t)(key >> 64));
+    result.argmax = (size_t)~(uint64_t)key;
+    result.min = key_to_elem(atomic_load(&stats->min_key));
+    result.sum = atomic_load(&stats->sum);
+    return result;
+}
+
+#else
+// Placeholder so the programs compile; parse_reduce_mode() never selects it
+typedef struct {
+    _Alignas(CACHE_LINE) ChunkStats stats;
+} AtomicStats;
+
+static inline void reset_atomic_stats(AtomicStats *stats) {
+    stats->stats = empty_stats();
+}
+
+static inline void atomic_combine_stats(AtomicStats *stats, const ChunkStats *other) {
+    combine_stats(&stats->stats, other);
+}
+
+static inline ChunkStats load_atomic_stats(AtomicStats *stats) {
+    return stats->stats;
+}
+#endif
+
+// Parses reduce strategy name, returns -1 if unknown
+static inline int parse_reduce_mode(const char *name) {
+    if (strcmp(name, "lock") == 0) {
+        return REDUCE_LOCK;
+    }
+    if (strcmp(name, "slots") == 0) {
+        return REDUCE_SLOTS;
+    }
+    if (strcmp(name, "atomic") == 0) {
+#ifndef REDUCE_ATOMIC_AVAILABLE
+        fprintf(stderr, "Reduce strategy 'atomic' needs a 16-byte CAS, only built on x86_64 (use lock or slots)\n");
+        exit(1);
+#endif
+        return REDUCE_ATOMIC;
+    }
+    return -1;
+}
+
+// Portable compare-and-branch loop, also used for SIMD tails
+static inline ChunkStats scan_chunk_scalar(const elem_t *data, int n) {
+    ChunkStats stats = {data[0], data[0], data[0], 0};
+    for (int i = 1; i < n; i++) {
+        if (data[i] > stats.max) {
+            stats.max = data[i];
+            stats.argmax = i;
+        }
+        if (data[i] < stats.min) {
+            stats.min = data[i];
+        }
+        stats.sum += data[i];
+    }
+    return stats;
+}
+
+#ifdef MAX_KERNELS_X86
+
+// Scalar tail starting at index start, folded into SIMD results
+static inline void scan_tail(const int *data, int start, int n, ChunkStats *stats) {
+    if (start < n) {
+        ChunkStats tail = scan_chunk_scalar(data + start, n - start);
+        tail.argmax += start;
+        combine_stats(stats, &tail);
+    }
+}
+
+// Reduces per-lane max/index/min vectors spilled to memory
+static inline void reduce_lanes(const int *max, const int *idx, const int *min, int lanes, ChunkStats *stats) {
+    for (int l = 0; l < lanes; l++) {
+        if (max[l] > stats->max || (max[l] == stats->max && (size_t)idx[l] < stats->argmax)) {
+            stats->max = max[l];
+            stats->argmax = idx[l];
+        }
+        if (min[l] < stats->min) {
+            stats->min = min[l];
+        }
+    }
+}
+
+
+// SSE4.1: two accumulators of 4 lanes, pmaxsd/pminsd plus blended lane indices
+__attribute__((target("sse4.1")))
+static inline ChunkStats scan_chunk_sse41(const int *data, int n) {
+    ChunkStats stats = {data[0], data[0], 0, 0};
+    int vec_end = n - n % 8;
+    if (vec_end == 0) {
+        return scan_chunk_scalar(data, n);
+    }
+
+    __m128i max0 = _mm_loadu_si128((const __m128i *)data);
+    __m128i max1 = _mm_loadu_si128((const __m128i *)(data + 4));
+    __m128i min0 = max0, min1 = max1;
+    __m128i idx0 = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i idx1 = _mm_setr_epi32(4, 5, 6, 7);
+    __m128i cur0 = idx0, cur1 = idx1;
+    __m128i sum0 = _mm_setzero_si128(), sum1 = _mm_setzero_si128();
+    const __m128i step = _mm_set1_epi32(8);
+
+    for (int i = 0; i < vec_end; i += 8) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(data + i + 4));
+
+        // Strict greater-than keeps the first index of each lane's max
+        idx0 = _mm_blendv_epi8(idx0, cur0, _mm_cmpgt_epi32(v0, max0));
+        idx1 = _mm_blendv_epi8(idx1, cur1, _mm_cmpgt_epi32(v1, max1));
+        max0 = _mm_max_epi32(max0, v0);
+        max1 = _mm_max_epi32(max1, v1);
+        min0 = _mm_min_epi32(min0, v0);
+        min1 = _mm_min_epi32(min1, v1);
+
+        // Sum in 64-bit lanes so large chunks cannot overflow
+        sum0 = _mm_add_epi64(sum0, _mm_add_epi64(_mm_cvtepi32_epi64(v0), _mm_cvtepi32_epi64(_mm_srli_si128(v0, 8))));
+        sum1 = _mm_add_epi64(sum1, _mm_add_epi64(_mm_cvtepi32_epi64(v1), _mm_cvtepi32_epi64(_mm_srli_si128(v1, 8))));
+
+        cur0 = _mm_add_epi32(cur0, step);
+        cur1 = _mm_add_epi32(cur1, step);
+    }
+
+    int max[8], idx[8], min[8];
+    long long sum[2];
+    _mm_storeu_si128((__m128i *)max, max0);
+    _mm_storeu_si128((__m128i *)(max + 4), max1);
+    _mm_storeu_si128((__m128i *)idx, idx0);
+    _mm_storeu_si128((__m128i *)(idx + 4), idx1);
+    _mm_storeu_si128((__m128i *)min, min0);
+    _mm_storeu_si128((__m128i *)(min + 4), min1);
+    _mm_storeu_si128((__m128i *)sum, _mm_add_epi64(sum0, sum1));
+    reduce_lanes(max, idx, min, 8, &stats);
+    stats.sum = sum[0] + sum[1];
+
+    scan_tail(data, vec_end, n, &stats);
+    return stats;
+}
+
+// AVX2: two accumulators of 8 lanes
+__attribute__((target("avx2")))
+static inline ChunkStats scan_chunk_avx2(const int *data, int n) {
+    ChunkStats stats = {data[0], data[0], 0, 0};
+    int vec_end = n - n % 16;
+    if (vec_end == 0) {
+        return scan_chunk_scalar(data, n);
+    }
+
+    __m256i max0 = _mm256_loadu_si256((const __m256i *)data);
+    __m256i max1 = _mm256_loadu_si256((const __m256i *)(data + 8));
+    __m256i min0 = max0, min1 = max1;
+    __m256i idx0 = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i idx1 = _mm256_setr_epi32(8, 9, 10, 11, 12, 13, 14, 15);
+    __m256i cur0 = idx0, cur1 = idx1;
+    __m256i sum0 = _mm256_setzero_si256(), sum1 = _mm256_setzero_si256();
+    const __m256i step = _mm256_set1_epi32(16);
+
+    for (int i = 0; i < vec_end; i += 16) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(data + i + 8));
+
+        idx0 = _mm256_blendv_epi8(idx0, cur0, _mm256_cmpgt_epi32(v0, max0));
+        idx1 = _mm256_blendv_epi8(idx1, cur1, _mm256_cmpgt_epi32(v1, max1));
+        max0 = _mm256_max_epi32(max0, v0);
+        max1 = _mm256_max_epi32(max1, v1);
+        min0 = _mm256_min_epi32(min0, v0);
+        min1 = _mm256_min_epi32(min1, v1);
+
+        sum0 = _mm256_add_epi64(sum0, _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(v0)),
+                                                       _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v0, 1))));
+        sum1 = _mm256_add_epi64(sum1, _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(v1)),
+                                                       _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v1, 1))));
+
+        cur0 = _mm256_add_epi32(cur0, step);
+        cur1 = _mm256_add_epi32(cur1, step);
+    }
+
+    int max[16], idx[16], min[16];
+    long long sum[4];
+    _mm256_storeu_si256((__m256i *)max, max0);
+    _mm256_storeu_si256((__m256i *)(max + 8), max1);
+    _mm256_storeu_si256((__m256i *)idx, idx0);
+    _mm256_storeu_si256((__m256i *)(idx + 8), idx1);
+    _mm256_storeu_si256((__m256i *)min, min0);
+    _mm256_storeu_si256((__m256i *)(min + 8), min1);
+    _mm256_storeu_si256((__m256i *)sum, _mm256_add_epi64(sum0, sum1));
+    reduce_lanes(max, idx, min, 16, &stats);
+    stats.sum = sum[0] + sum[1] + sum[2] + sum[3];
+
+    scan_tail(data, vec_end, n, &stats);
+    return stats;
+}
+
+// AVX-512: two accumulators of 16 lanes, mask registers pick the new indices
+__attribute__((target("avx512f")))
+static inline ChunkStats scan_chunk_avx512(const int *data, int n) {
+    ChunkStats stats = {data[0], data[0], 0, 0};
+    int vec_end = n - n % 32;
+    if (vec_end == 0) {
+        return scan_chunk_scalar(data, n);
+    }
+
+    __m512i max0 = _mm512_loadu_si512((const void *)data);
+    __m512i max1 = _mm512_loadu_si512((const void *)(data + 16));
+    __m512i min0 = max0, min1 = max1;
+    __m512i idx0 = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i idx1 = _mm512_add_epi32(idx0, _mm512_set1_epi32(16));
+    __m512i cur0 = idx0, cur1 = idx1;
+    __m512i sum0 = _mm512_setzero_si512(), sum1 = _mm512_setzero_si512();
+    const __m512i step = _mm512_set1_epi32(32);
+
+    for (int i = 0; i < vec_end; i += 32) {
+        __m512i v0 = _mm512_loadu_si512((const void *)(data + i));
+        __m512i v1 = _mm512_loadu_si512((const void *)(data + i + 16));
+
+        idx0 = _mm512_mask_mov_epi32(idx0, _mm512_cmpgt_epi32_mask(v0, max0), cur0);
+        idx1 = _mm512_mask_mov_epi32(idx1, _mm512_cmpgt_epi32_mask(v1, max1), cur1);
+        max0 = _mm512_max_epi32(max0, v0);
+        max1 = _mm512_max_epi32(max1, v1);
+        min0 = _mm512_min_epi32(min0, v0);
+        min1 = _mm512_min_epi32(min1, v1);
+
+        sum0 = _mm512_add_epi64(sum0, _mm512_add_epi64(_mm512_cvtepi32_epi64(_mm512_castsi512_si256(v0)),
+                                                       _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(v0, 1))));
+        sum1 = _mm512_add_epi64(sum1, _mm512_add_epi64(_mm512_cvtepi32_epi64(_mm512_castsi512_si256(v1)),
+                                                       _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(v1, 1))));
+
+        cur0 = _mm512_add_epi32(cur0, step);
+        cur1 = _mm512_add_epi32(cur1, step);
+    }
+
+    int max[32], idx[32], min[32];
+    _mm512_storeu_si512((void *)max, max0);
+    _mm512_storeu_si512((void *)(max + 16), max1);
+    _mm512_storeu_si512((void *)idx, idx0);
+    _mm512_storeu_si512((void *)(idx + 16), idx1);
+    _mm512_storeu_si512((void *)min, min0);
+    _mm512_storeu_si512((void *)(min + 16), min1);
+    reduce_lanes(max, idx, min, 32, &stats);
+    stats.sum = _mm512_reduce_add_epi64(_mm512_add_epi64(sum0, sum1));
+
+    scan_tail(data, vec_end, n, &stats);
+    return stats;
+}
+
+#endif
+
+// Kernel picked by select_scan_kernel()
+static ChunkStats (*scan_chunk)(const elem_t *data, int n) = scan_chunk_scalar;
+
+// Scans n elements of any size, splitting into blocks the kernels can index
+static inline ChunkStats scan_range(const elem_t *data, size_t n) {
+    ChunkStats stats = scan_chunk(data, (int)((n < SCAN_BLOCK) ? n : SCAN_BLOCK));
+    for (size_t start = SCAN_BLOCK; start < n; start += SCAN_BLOCK) {
+        ChunkStats block = scan_chunk(data + start, (int)((n - start < SCAN_BLOCK) ? n - start : SCAN_BLOCK));
+        block.argmax += start;
+        combine_stats(&stats, &block);
+    }
+    return stats;
+}
+
+// Picks the widest kernel this CPU supports and returns its name
+static inline const char *select_scan_kernel(void) {
+#ifdef MAX_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        scan_chunk = scan_chunk_avx512;
+        return "avx512";
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        scan_chunk = scan_chunk_avx2;
+        return "avx2";
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        scan_chunk = scan_chunk_sse41;
+        return "sse4.1";
+    }
+#endif
+    scan_chunk = scan_chunk_scalar;
+    return "scalar";
+}
+
+#endif
@@ -0,0 +1,490 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <semaphore.h>
+#include <time.h>
+#include <limits.h>
+#include "max_kernels.h"
+#include "thread_pool.h"
+#include "process_pool.h"
+#include "bench_options.h"
+#include "bench_report.h"
+#include "arena.h"
+
+// Hybrid max value: one worker process per portion of a shared array, each
+// running its own thread team over that portion. Threads fold their chunks
+// into per-thread slots, the process combines them (thread level) and
+// publishes one result with the selected reduce strategy (process level).
+// -w lists process counts and -T threads per process; every pair runs.
+
+#define SCAN_GRAIN 8192             // Elements per scan task, many tasks per thread
+
+// Global Variables
+elem_t *array;
+size_t ARRAY_SIZE;                  // Set by -n
+int NUM_PROCESSES;
+int NUM_THREADS;                    // Threads per process in the current config
+ProcessPool pool;                   // Worker processes reused by every config
+int reduce_mode;                    // REDUCE_LOCK, REDUCE_SLOTS or REDUCE_ATOMIC
+int verbose;                        // Per-process progress lines (-v)
+int smaps_enabled;                  // Read child PSS / USS (-m)
+int perf_enabled;                   // Counters of every team thread (-p)
+PerfSet perf;                       // Counters of the parent (-p)
+int affinity;                       // Processes tied to nodes, threads pinned to its CPUs (-a)
+int input_dist;                     // DIST_* of the generated array (-d)
+uint64_t input_seed;                // Generator seed (-s)
+int max_threads;                    // Team size of every worker process
+int *chunk_ids;                     // 0, 1, 2, ... for team task arguments
+Arena arena;                        // Shared: the generated array (-H)
+
+// Shared with the workers
+int *team_size;                     // NUM_THREADS of the current config, set by the parent
+ChunkStats *global_stats;           // Max, min, sum and argmax of whole array
+sem_t *mutex;
+PaddedStats *process_stats;         // One result slot per process (slots mode)
+AtomicStats *atomic_stats;          // Lock-free global result (atomic mode)
+ChildReport *child_reports;         // One heap, fault, counter and memory slot per process
+SliceTiming *timings;               // Scan time of each process's portion (affinity mode)
+
+// Private to each worker process, set up by start_team()
+int process_id;                     // Pool index of this worker
+ThreadPool team;                    // Threads scanning this process's portion
+PaddedStats *thread_stats;          // Thread level reduce slot of each team thread
+PerfSet team_perf;                  // Counters of the worker's main thread (slot 0) and team (-p)
+
+// Index of part i of n equal parts of length elements; quotient and
+// remainder are scaled apart, so nothing overflows a size_t
+size_t split_point(size_t length, int i, int n) {
+    return length / n * i + length % n * i / n;
+}
+
+// First index of process p's portion; portion NUM_PROCESSES starts at ARRAY_SIZE
+size_t portion_start(int p) {
+    return split_point(ARRAY_SIZE, p, NUM_PROCESSES);
+}
+
+// First index of thread t's slice of this process's portion
+size_t slice_start(int t) {
+    size_t first = portion_start(process_id);
+    return first + split_point(portion_start(process_id + 1) - first, t, NUM_THREADS);
+}
+
+// Node a worker process and its portion are tied to in affinity mode
+int process_node(int p) {
+    return worker_node(p);
+}
+
+// Starts the team of worker id, which keeps it for its lifetime; in
+// affinity mode its threads are pinned to CPUs of the process's node
+void start_team(int id, int count) {
+    (void)count;
+    process_id = id;
+    pool_init(&team, max_threads);
+    thread_stats = aligned_alloc(CACHE_LINE, max_threads * sizeof(PaddedStats));
+    if (affinity) {
+        for (int t = 0; t < max_threads; t++) {
+            int k = (id / placement.nodes) * max_threads + t;
+            pin_worker(pool_worker_tid(&team, t), node_worker(process_node(id), k));
+        }
+    }
+    if (perf_enabled) {
+        pid_t tids[max_threads + 1];
+        tids[0] = 0;
+        for (int t = 0; t < max_threads; t++) {
+            tids[t + 1] = pool_worker_tid(&team, t);
+        }
+        perf_set_open(&team_perf, tids, max_threads + 1);
+    }
+}
+
+// Stops the team of a worker process
+void stop_team(int id, int count) {
+    (void)id;
+    (void)count;
+    perf_set_close(&team_perf);
+    pool_destroy(&team);
+    free(thread_stats);
+}
+
+// Adopts the parent's config in this worker's copy of the globals
+void enter_config(int id, int count) {
+    process_id = id;
+    NUM_PROCESSES = count;
+    NUM_THREADS = *team_size;
+    pool_set_active(&team, NUM_THREADS);
+}
+
+// Runs fn once per thread slice of the team; in affinity mode slice t runs
+// on pinned thread t
+void run_team_slices(task_fn fn) {
+    if (affinity) {
+        pool_run_pinned(&team, fn, chunk_ids, NUM_THREADS);
+    } else {
+        pool_run(&team, fn, chunk_ids, NUM_THREADS);
+    }
+}
+
+// Fills thread id's slice; every element depends only on its index, so the
+// array is the same for any grid
+void* fill_slice(void* arg) {
+    int t = *(int *)arg;
+    generate_range(array, slice_start(t), slice_start(t + 1), ARRAY_SIZE, input_dist, input_seed);
+    return NULL;
+}
+
+// Faults in thread id's slice before the timed runs (-P)
+void* prefault_slice(void* arg) {
+    int t = *(int *)arg;
+    prefault(&array[slice_start(t)], (slice_start(t + 1) - slice_start(t)) * sizeof(elem_t));
+    return NULL;
+}
+
+// Fills portion id of count with the team of its worker process
+void fill_portion(int id, int count) {
+    enter_config(id, count);
+    run_team_slices(fill_slice);
+}
+
+// Prefaults portion id of count with the team of its worker process
+void prefault_portion(int id, int count) {
+    enter_config(id, count);
+    run_team_slices(prefault_slice);
+}
+
+// Scans chunk id of this process's portion into the running thread's slot
+// Chunks are small and outnumber threads; threads claim them through
+// pool_for() until none are left
+void scan_claimed_chunk(long chunk, void* arg) {
+    (void)arg;
+    size_t start = portion_start(process_id) + (size_t)chunk * SCAN_GRAIN;
+    size_t end = portion_start(process_id + 1);
+    size_t length = (start + SCAN_GRAIN < end) ? SCAN_GRAIN : end - start;
+    ChunkStats local = scan_chunk(&array[start], length);
+    local.argmax += start;
+    combine_stats(&thread_stats[current_worker].stats, &local);
+}
+
+// Scans pinned thread id's whole slice into its slot (affinity mode)
+void* scan_slice_task(void* arg) {
+    int t = *(int *)arg;
+    size_t start = slice_start(t);
+    size_t length = slice_start(t + 1) - start;
+    if (length > 0) {
+        ChunkStats local = scan_range(&array[start], length);
+        local.argmax += start;
+        combine_stats(&thread_stats[t].stats, &local);
+    }
+    return NULL;
+}
+
+// Computes the stats of portion id of count with this process's team and
+// publishes them, run by a pool worker process
+void scan_portion(int id, int count) {
+    // Worker measures itself from here until its result is published
+    long long heap_mark = child_report_begin();
+    perf_set_mark(&team_perf, max_threads + 1, NULL);
+    struct timespec t_start, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    enter_config(id, count);
+
+    size_t start = portion_start(id);
+    size_t end = portion_start(id + 1);
+    if (verbose) {
+        printf("\tProcess %d (PID=%d): %d threads scanning %zu to %zu\n", id, getpid(), NUM_THREADS, start, end - 1);
+        fflush(stdout);
+    }
+
+    // ---- Thread Level -------------------------------------------------------
+    // Every team thread folds the chunks it runs into its own slot, then the
+    // process combines the slots
+    for (int t = 0; t < NUM_THREADS; t++) {
+        thread_stats[t].stats = empty_stats();
+    }
+    if (affinity) {
+        pool_run_pinned(&team, scan_slice_task, chunk_ids, NUM_THREADS);
+    } else {
+        pool_for(&team, (long)((end - start + SCAN_GRAIN - 1) / SCAN_GRAIN), scan_claimed_chunk, NULL);
+    }
+    ChunkStats local = empty_stats();
+    for (int t = 0; t < NUM_THREADS; t++) {
+        combine_stats(&local, &thread_stats[t].stats);
+    }
+
+    // ---- Process Level ------------------------------------------------------
+    if (reduce_mode == REDUCE_SLOTS) {
+        // Own slot, combined by parent after the pool run
+        process_stats[id].stats = local;
+    } else if (reduce_mode == REDUCE_ATOMIC) {
+        // Lock-free update of shared global stats
+        atomic_combine_stats(atomic_stats, &local);
+    } else {
+        // Updates global stats protected with semaphore
+        sem_wait(mutex);
+        combine_stats(global_stats, &local);
+        sem_post(mutex);
+    }
+
+    if (affinity) {
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+        timings[id].seconds = (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+        timings[id].bytes = (end - start) * sizeof(elem_t);
+    }
+
+    // Collect worker memory usage and the team's counters
+    child_report_end(&child_reports[id], heap_mark, smaps_enabled);
+    perf_set_mark(&team_perf, max_threads + 1, &child_reports[id].map.perf);
+}
+
+// Runs fn for every portion on the pool; in affinity mode portion i runs on worker i
+void run_portions(proc_task_fn fn) {
+    if (affinity) {
+        proc_pool_run_pinned(&pool, fn, NUM_PROCESSES);
+    } else {
+        proc_pool_run(&pool, fn, NUM_PROCESSES);
+    }
+}
+
+// Main Method
+int main(int argc, char *argv[]) {
+    // Pick SIMD scan kernel for this CPU, inherited by the worker processes
+    const char *kernel = select_scan_kernel();
+
+    // Array size, process and thread counts and process level reduce strategy:
+    // lock (default), slots or atomic
+    Options opts;
+    if (parse_options(argc, argv, &opts, "[lock|slots|atomic]") != 0) {
+        return 1;
+    }
+    const char *reduce_name = opts.mode ? opts.mode : "lock";
+    reduce_mode = parse_reduce_mode(reduce_name);
+    if (reduce_mode < 0) {
+        fprintf(stderr, "Unknown reduce strategy '%s' (expected lock, slots or atomic)\n", reduce_name);
+        return 1;
+    }
+    if (opts.num_configs * opts.num_thread_configs > MAX_CONFIGS) {
+        fprintf(stderr, "%d x %d grid is larger than %d configs\n", opts.num_configs, opts.num_thread_configs,
+                MAX_CONFIGS);
+        return 1;
+    }
+    if (opts.top_k > 0 || opts.range_queries > 0) {
+        fprintf(stderr, "Note: -k and -q are answered by the max value thread and process programs only\n");
+    }
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if ((long)opts.max_workers * opts.max_threads > cores) {
+        fprintf(stderr, "Note: up to %d x %d threads requested, %ld cores online\n", opts.max_workers,
+                opts.max_threads, cores);
+    }
+
+    verbose = opts.verbose;
+    affinity = opts.affinity;
+    input_dist = opts.dist;
+    input_seed = opts.seed;
+    smaps_enabled = opts.smaps;
+    perf_enabled = opts.perf;
+    max_threads = opts.max_threads;
+    FILE *report = open_report(&opts);
+
+    // Shared Memory; a -i file is mapped shared, so every worker scans the
+    // same page cache pages, a generated array comes from a shared arena
+    if (opts.input != NULL) {
+        array = map_file(opts.input, sizeof(elem_t), &ARRAY_SIZE, 0);
+        opts.n = ARRAY_SIZE;
+    } else {
+        ARRAY_SIZE = opts.n;
+        arena_reserve(&arena, ARRAY_SIZE * sizeof(elem_t) + HUGE_PAGE_SIZE, 1, opts.pages);
+        array = arena_take(&arena, ARRAY_SIZE * sizeof(elem_t));
+    }
+    team_size = mmap(NULL, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    global_stats = mmap(NULL, sizeof(ChunkStats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    mutex = mmap(NULL, sizeof(sem_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    process_stats = mmap(NULL, opts.max_workers * sizeof(PaddedStats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    atomic_stats = mmap(NULL, sizeof(AtomicStats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    child_reports = mmap(NULL, opts.max_workers * sizeof(ChildReport), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    timings = mmap(NULL, opts.max_workers * sizeof(SliceTiming), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    // Task arguments for the largest team
+    chunk_ids = malloc(max_threads * sizeof(int));
+    for (int i = 0; i < max_threads; i++) {
+        chunk_ids[i] = i;
+    }
+
+    // Topology is read before the fork, so every worker knows its node
+    if (affinity) {
+        placement_init();
+    }
+
+    // Fork workers once, sized for the largest process count, after all
+    // shared memory they use is mapped; each then starts its own team
+    proc_pool_init(&pool, opts.max_workers);
+    proc_pool_run_pinned(&pool, start_team, opts.max_workers);
+    if (affinity) {
+        printf(" - Affinity: %d processes over %d NUMA nodes, threads pinned to their node's CPUs\n",
+               opts.max_workers, placement.nodes);
+    }
+
+    // Counters for the parent; every worker counts its own team
+    if (opts.perf) {
+        pid_t self = 0;
+        perf_set_open(&perf, &self, 1);
+    }
+
+    printf("------------------------------------------------------------------------------------------------------------------------\n");
+    BenchResult results[MAX_CONFIGS];   // Timing statistics of each grid cell
+    double *samples = malloc(opts.reps * sizeof(double));
+
+    struct timespec c_start, c_end;
+    printf(" - Array: %zu x %s\n", ARRAY_SIZE, ELEM_NAME);
+    printf(" - Scan kernel: %s\n", kernel);
+    if (opts.input != NULL) {
+        printf(" - Input: %s\n", opts.input);
+    } else {
+        printf(" - Input: %s, seed %llu\n", distribution_names[input_dist], (unsigned long long)input_seed);
+        printf(" - Arena: %zu MB, %s pages%s\n", arena.size >> 20, page_mode_names[arena.pages],
+               opts.prefault ? ", prefaulted" : "");
+    }
+    printf(" - Reduce strategy: %s between processes, slots between threads\n", reduce_name);
+
+    // Sweep the grid: every process count with every thread count
+    int cell = 0;
+    for (int p = 0; p < opts.num_configs; p++) {
+        for (int t = 0; t < opts.num_thread_configs; t++, cell++) {
+            NUM_PROCESSES = opts.workers[p];
+            if ((size_t)NUM_PROCESSES > ARRAY_SIZE) {
+                NUM_PROCESSES = ARRAY_SIZE;     // Every process needs at least one element
+            }
+            NUM_THREADS = opts.threads[t];
+            *team_size = NUM_THREADS;
+            proc_pool_set_active(&pool, NUM_PROCESSES);
+            printf(" - %d PROCESS%s x %d THREAD%s:\n", NUM_PROCESSES, (NUM_PROCESSES == 1) ? "" : "ES",
+                   NUM_THREADS, (NUM_THREADS == 1) ? "" : "S");
+
+            // Bind each process's portion to its node before the fill touches it
+            if (affinity && opts.input == NULL) {
+                for (int i = 0; i < NUM_PROCESSES; i++) {
+                    place_pages(&array[portion_start(i)], (portion_start(i + 1) - portion_start(i)) * sizeof(elem_t),
+                                process_node(i));
+                }
+            }
+
+            // Fault the pages in before the timed runs instead of on first touch
+            if (opts.prefault && opts.input == NULL) {
+                clock_gettime(CLOCK_MONOTONIC, &c_start);
+                run_portions(prefault_portion);
+                clock_gettime(CLOCK_MONOTONIC, &c_end);
+                printf("    - Prefault: %f sec\n", (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9);
+            }
+
+            // Generate & Fill Array in parallel, which the scan never modifies
+            if (opts.input == NULL) {
+                run_portions(fill_portion);
+            }
+
+            // Print Array
+            printf("    - Array (first 20 elements):\n\t");
+            for (size_t i = 0; i < 20 && i < ARRAY_SIZE; i++) {
+                printf(ELEM_FMT " ", ELEM_PRINT(array[i]));
+            }
+            printf("\n\n");
+            printf("    - Finding Global Max:\n");
+
+            // Warmup runs first, then timed runs
+            begin_result(&results[cell], NUM_PROCESSES, NUM_PROCESSES);
+            results[cell].threads = NUM_THREADS;
+            for (int rep = -opts.warmups; rep < opts.reps; rep++) {
+                *global_stats = empty_stats();
+                reset_atomic_stats(atomic_stats);
+                sem_init(mutex, 1, 1);
+                fflush(stdout);
+
+                // Start memory window and time before execution
+                reset_peak_rss();
+                phase_mark(&perf, 1, NULL);
+                clock_gettime(CLOCK_MONOTONIC, &c_start);
+
+                // ---- Map Phase ----------------------------------------------
+                // One portion per process, each scanned by its team and
+                // reduced at both levels before the pool run returns
+                run_portions(scan_portion);
+                phase_mark(&perf, 1, (rep >= 0) ? &results[cell].map : NULL);
+
+                // Combine lock-free results
+                if (reduce_mode == REDUCE_SLOTS) {
+                    for (int i = 0; i < NUM_PROCESSES; i++) {
+                        combine_stats(global_stats, &process_stats[i].stats);
+                    }
+                } else if (reduce_mode == REDUCE_ATOMIC) {
+                    *global_stats = load_atomic_stats(atomic_stats);
+                }
+
+                // Record time and memory after execution
+                clock_gettime(CLOCK_MONOTONIC, &c_end);
+                phase_mark(&perf, 1, (rep >= 0) ? &results[cell].reduce : NULL);
+                sem_destroy(mutex);
+
+                if (rep >= 0) {
+                    // Workers ran the map phase and both reduce levels inside it
+                    record_run(&results[cell], read_peak_rss_kb(), child_reports);
+                    if (affinity) {
+                        record_slices(&results[cell], timings, NUM_PROCESSES);
+                    }
+                    samples[rep] = (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9;
+                }
+            }
+            printf("\n\t - All processes finished -\n");
+
+            // Output Result
+            printf("\n    - Global Max: " ELEM_FMT " (index %zu)\n", ELEM_PRINT(global_stats->max), global_stats->argmax);
+            printf("    - Global Min: " ELEM_FMT "\n", ELEM_PRINT(global_stats->min));
+            printf("    - Sum: " SUM_FMT "\n", global_stats->sum);
+
+            // Calculate execution time statistics
+            summarize_samples(samples, opts.reps, ARRAY_SIZE, &results[cell]);
+            printf("\n    - Execution Time: %f sec (median of %d, p95 %f, stddev %f)",
+                   results[cell].median, opts.reps, results[cell].p95, results[cell].stddev);
+
+            // Memory high water marks of parent and children, heap bytes per run
+            printf("\n\n    - Peak RSS: %ld KB (parent), %ld KB (largest child)\n",
+                   results[cell].peak_rss_kb, results[cell].child_peak_kb);
+            if (smaps_enabled) {
+                printf("    - Children: %ld KB PSS, %ld KB USS\n", results[cell].child_pss_kb,
+                       results[cell].child_uss_kb);
+            }
+            printf("    - Heap Allocated: %lld B map (children included), %lld B reduce",
+                   results[cell].map.alloc_bytes, results[cell].reduce.alloc_bytes);
+            printf("\n    - Page Faults: %lld map (children included), %lld reduce",
+                   results[cell].map.faults, results[cell].reduce.faults);
+
+            printf("\n------------------------------------------------------------------------------------------------------------------------\n");
+        }
+    }
+
+    // Print performance data for every grid cell
+    fflush(stdout);
+    Options grid = opts;
+    grid.num_configs = cell;
+    print_report(report, &grid, "max_value_hybrid", reduce_name, "Procs x T", results);
+    free(samples);
+
+    // Stop teams and workers, then release memory
+    perf_set_close(&perf);
+    proc_pool_set_active(&pool, opts.max_workers);
+    proc_pool_run_pinned(&pool, stop_team, opts.max_workers);
+    proc_pool_destroy(&pool);
+    free(chunk_ids);
+    if (opts.input != NULL) {
+        munmap(array, ARRAY_SIZE * sizeof(elem_t));
+    } else {
+        arena_release(&arena);
+    }
+    munmap(team_size, sizeof(int));
+    munmap(global_stats, sizeof(ChunkStats));
+    munmap(mutex, sizeof(sem_t));
+    munmap(process_stats, opts.max_workers * sizeof(PaddedStats));
+    munmap(atomic_stats, sizeof(AtomicStats));
+    munmap(child_reports, opts.max_workers * sizeof(ChildReport));
+    munmap(timings, opts.max_workers * sizeof(SliceTiming));
+    return 0;
+}
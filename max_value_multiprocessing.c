@@ -3,181 +3,461 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
-#include <sys/wait.h>
 #include <sys/mman.h>
 #include <semaphore.h>
 #include <time.h>
-
-// Array Size
-#define ARRAY_SIZE 131072
+#include <limits.h>
+#include "max_kernels.h"
+#include "select_kernels.h"
+#include "process_pool.h"
+#include "bench_options.h"
+#include "bench_report.h"
+#include "arena.h"
 
 // Global Variables
-int *array;
-int chunk_size;
-int *global_max;
+elem_t *array;
+size_t ARRAY_SIZE;                  // Set by -n
+size_t chunk_size;
+ChunkStats *global_stats;           // Max, min, sum and argmax of whole array
 sem_t *mutex;
-long *child_mem;
 int NUM_PROCESSES;
+int reduce_mode;                    // REDUCE_LOCK, REDUCE_SLOTS or REDUCE_ATOMIC
+PaddedStats *worker_stats;          // One shared result slot per process (slots mode)
+AtomicStats *atomic_stats;          // Shared lock-free global result (atomic mode)
+ProcessPool pool;                   // Worker processes reused by every config
+int verbose;                        // Per-process progress lines (-v)
+int smaps_enabled;                  // Read child PSS / USS (-m)
+ChildReport *child_reports;         // One shared heap and memory slot per task
+PerfSet perf;                       // Counters of parent (slot 0) and workers (-p)
+int affinity;                       // Chunk i always runs on pinned worker i (-a)
+int input_dist;                     // DIST_* of the generated array (-d)
+uint64_t input_seed;                // Generator seed (-s)
+SliceTiming *timings;               // Shared scan time of each chunk (affinity mode)
+Arena arena;                        // Shared: array and the large query buffers (-H)
 
-// Returns current memory usage by program
-long get_memory_usage() {
-    FILE* fp = fopen("/proc/self/status", "r");
-    if (fp == NULL) {
-        perror("Error opening /proc/self/status");
-        return 0;
-    }
-    char line[256];
-    long vm_rss = -1;
-    while (fgets(line, sizeof(line), fp) != NULL) {
-        if (strncmp(line, "VmRSS:", 6) == 0) {
-            sscanf(line + 6, "%ld", &vm_rss);
-            break;
-        }
-    }
+// Query Variables (-k), shared with the workers unless noted
+size_t top_k;                       // Values of the top-k query, 0 for no queries
+TopK *worker_heaps;                 // Bounded heap of each chunk
+elem_t *heap_items;                 // top_k slots per chunk
+TopK top_values;                    // Merged heap in the parent, sorted largest first after the reduce
+elem_t kth_largest;                 // Smallest of the top k (parent)
+elem_t p50, p99;                    // Percentiles from select_rank() (parent)
+SelectCounts *select_counts;        // Pass counts of each chunk
+elem_t *candidates;                 // Elements inside the bracket, at their chunk's offset
+elem_t *select_sample;              // Scratch for select_bracket() (parent)
+elem_t *bracket;                    // low and high of the current pass
+
+// Fills chunk id of count with the generated input, run by a pool worker process
+// Every element depends only on its index, so the array is the same for any count
+void fill_chunk(int id, int count) {
+    size_t start = id * (ARRAY_SIZE / count);
+    size_t end = (id == count - 1) ? ARRAY_SIZE : start + ARRAY_SIZE / count;
+    generate_range(array, start, end, ARRAY_SIZE, input_dist, input_seed);
+}
 
-    fclose(fp);
-    return vm_rss;
+// Faults in chunk id of count of array and of the query candidates before
+// the timed runs (-P); the pages are shared, so every process finds them present
+void prefault_chunk(int id, int count) {
+    size_t start = id * (ARRAY_SIZE / count);
+    size_t end = (id == count - 1) ? ARRAY_SIZE : start + ARRAY_SIZE / count;
+    if (arena_owns(&arena, array)) {
+        prefault(&array[start], (end - start) * sizeof(elem_t));
+    }
+    if (candidates != NULL) {
+        prefault(&candidates[start], (end - start) * sizeof(elem_t));
+    }
 }
 
-// Computes maximum value within assigned chunk
-void find_local_max(int id) {
+// Computes maximum value within assigned chunk, run by a pool worker process
+void find_local_max(int id, int count) {
+    // Worker measures itself from here until its result is published
+    long long heap_mark = child_report_begin();
+    struct timespec t_start, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+
+    // Adopt the parent's config in this worker's copy of the globals
+    NUM_PROCESSES = count;
+    chunk_size = ARRAY_SIZE / count;
 
     // Determine start and end for thread chunk
-    int start = id * chunk_size;
-    int end = 0;
+    size_t start = id * chunk_size;
+    size_t end = 0;
     if (id == NUM_PROCESSES - 1) {
                 end = ARRAY_SIZE - 1;
             } else {
                 end = start + chunk_size - 1;
             }
 
-    printf("\tProcess %d (PID=%d): sorting %d to %d\n", id, getpid(), start, end);
-    fflush(stdout);
-
-    // Compute local max
-    int local_max = array[start];
-    for (int i = start + 1; i <= end; i++) {
-        if (array[i] > local_max) {
-            local_max = array[i];
-        }
+    if (verbose) {
+        printf("\tProcess %d (PID=%d): sorting %zu to %zu\n", id, getpid(), start, end);
+        fflush(stdout);
     }
 
+    // Compute local max, min, sum and argmax in one pass
+    ChunkStats local = scan_range(&array[start], end - start + 1);
+    local.argmax += start;
+
     // ---- Reduce Phase -------------------------------------------------------
-    // Updates global max protected with mutex
-    sem_wait(mutex);
-    if (local_max > *global_max) {
-        *global_max = local_max;
+    if (reduce_mode == REDUCE_SLOTS) {
+        // Own slot, combined by parent after the pool run
+        worker_stats[id].stats = local;
+    } else if (reduce_mode == REDUCE_ATOMIC) {
+        // Lock-free update of shared global stats
+        atomic_combine_stats(atomic_stats, &local);
+    } else {
+        // Updates global stats protected with mutex
+        sem_wait(mutex);
+        combine_stats(global_stats, &local);
+        sem_post(mutex);
+    }
+
+    if (affinity) {
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+        timings[id].seconds = (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+        timings[id].bytes = (end - start + 1) * sizeof(elem_t);
+    }
+
+    // Collect worker memory usage
+    child_report_end(&child_reports[id], heap_mark, smaps_enabled);
+}
+
+// First index of chunk id of count; the last chunk also takes the remainder
+size_t chunk_start(int id, int count) {
+    return (id < count) ? id * (ARRAY_SIZE / count) : ARRAY_SIZE;
+}
+
+// Runs fn for every chunk on the pool; in affinity mode chunk i runs on worker i
+void run_chunks(proc_task_fn fn) {
+    if (affinity) {
+        proc_pool_run_pinned(&pool, fn, NUM_PROCESSES);
+    } else {
+        proc_pool_run(&pool, fn, NUM_PROCESSES);
     }
-    sem_post(mutex);
+}
+
+// Top-k task: offers chunk id of count to its own bounded heap
+void topk_chunk(int id, int count) {
+    topk_init(&worker_heaps[id], top_k, &heap_items[(size_t)id * top_k]);
+    topk_scan(&worker_heaps[id], &array[chunk_start(id, count)], chunk_start(id + 1, count) - chunk_start(id, count));
+}
+
+// Order statistic task: counts chunk id of count against the bracket and
+// copies the elements inside it to the same offset of candidates
+void select_chunk(int id, int count) {
+    size_t start = chunk_start(id, count);
+    select_scan(&array[start], chunk_start(id + 1, count) - start, bracket[0], bracket[1], &select_counts[id],
+                &candidates[start]);
+}
 
-    // Collect child process memory usage
-    child_mem[id] = get_memory_usage();
+// Element of rank r: one pass over all chunks, and a second one in the rare
+// case that the sampled bracket missed r
+elem_t select_rank(size_t r) {
+    select_bracket(array, ARRAY_SIZE, r, select_sample, &bracket[0], &bracket[1]);
+    SelectCounts total;
+    elem_t result;
+    do {
+        run_chunks(select_chunk);
 
-    _exit(0);
+        // Gather the elements inside the bracket at the front of candidates
+        total = (SelectCounts){0};
+        for (int c = 0; c < NUM_PROCESSES; c++) {
+            memmove(&candidates[total.inside], &candidates[chunk_start(c, NUM_PROCESSES)],
+                    select_counts[c].inside * sizeof(elem_t));
+            select_add(&total, &select_counts[c]);
+        }
+    } while (!select_resolve(&total, candidates, r, global_stats->min, global_stats->max,
+                             &bracket[0], &bracket[1], &result));
+    return result;
+}
+
+// Answers the -k queries on the scanned array: per-chunk heaps merged into
+// the top k by the parent, then p50 and p99; stores the seconds each part took
+void run_queries(double *topk_seconds, double *select_seconds) {
+    struct timespec t_start, t_heaps, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    run_chunks(topk_chunk);
+    topk_init(&top_values, top_k, top_values.items);
+    for (int c = 0; c < NUM_PROCESSES; c++) {
+        topk_merge(&top_values, &worker_heaps[c]);
+    }
+    kth_largest = top_values.items[0];
+    topk_sort(&top_values);
+    clock_gettime(CLOCK_MONOTONIC, &t_heaps);
+
+    p50 = select_rank(percentile_rank(ARRAY_SIZE, 50));
+    p99 = select_rank(percentile_rank(ARRAY_SIZE, 99));
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+    *topk_seconds = (t_heaps.tv_sec - t_start.tv_sec) + (t_heaps.tv_nsec - t_start.tv_nsec) / 1e9;
+    *select_seconds = (t_end.tv_sec - t_heaps.tv_sec) + (t_end.tv_nsec - t_heaps.tv_nsec) / 1e9;
 }
 
 // Main Method
-int main(void) {
-    // Shared Memory
-    array = mmap(NULL, ARRAY_SIZE * sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-    global_max = mmap(NULL, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+int main(int argc, char *argv[]) {
+    // Pick SIMD scan kernel for this CPU, inherited by the worker processes
+    const char *kernel = select_scan_kernel();
+
+    // Array size, process counts and reduce strategy: lock (default), slots or atomic
+    Options opts;
+    if (parse_options(argc, argv, &opts, "[lock|slots|atomic]") != 0) {
+        return 1;
+    }
+    const char *reduce_name = opts.mode ? opts.mode : "lock";
+    reduce_mode = parse_reduce_mode(reduce_name);
+    if (reduce_mode < 0) {
+        fprintf(stderr, "Unknown reduce strategy '%s' (expected lock, slots or atomic)\n", reduce_name);
+        return 1;
+    }
+
+    verbose = opts.verbose;
+    affinity = opts.affinity;
+    input_dist = opts.dist;
+    input_seed = opts.seed;
+    smaps_enabled = opts.smaps;
+    FILE *report = open_report(&opts);
+
+    // Shared Memory; a -i file is mapped shared, so every worker scans the
+    // same page cache pages, a generated array and the large query buffers
+    // come from one shared arena
+    if (opts.input != NULL) {
+        array = map_file(opts.input, sizeof(elem_t), &ARRAY_SIZE, 0);
+        opts.n = ARRAY_SIZE;
+    } else {
+        ARRAY_SIZE = opts.n;
+    }
+    top_k = (opts.top_k < ARRAY_SIZE) ? opts.top_k : ARRAY_SIZE;
+    size_t array_elems = (opts.input == NULL) ? ARRAY_SIZE : 0;
+    size_t query_elems = (top_k > 0) ? ARRAY_SIZE + (size_t)(opts.max_workers + 1) * top_k + SELECT_SAMPLE : 0;
+    arena_reserve(&arena, (array_elems + query_elems) * sizeof(elem_t) + 5 * HUGE_PAGE_SIZE, 1, opts.pages);
+    if (array_elems > 0) {
+        array = arena_take(&arena, array_elems * sizeof(elem_t));
+    }
+    global_stats = mmap(NULL, sizeof(ChunkStats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
     mutex = mmap(NULL, sizeof(sem_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-    child_mem = mmap(NULL, 8 * sizeof(long), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    worker_stats = mmap(NULL, opts.max_workers * sizeof(PaddedStats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    atomic_stats = mmap(NULL, sizeof(AtomicStats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    child_reports = mmap(NULL, opts.max_workers * sizeof(ChildReport), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    timings = mmap(NULL, opts.max_workers * sizeof(SliceTiming), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    // Query buffers; heap pointers set by the workers point into heap_items,
+    // mapped at the same address in every process
+    if (top_k > 0) {
+        worker_heaps = mmap(NULL, opts.max_workers * sizeof(TopK), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        heap_items = arena_take(&arena, (size_t)opts.max_workers * top_k * sizeof(elem_t));
+        top_values.items = arena_take(&arena, top_k * sizeof(elem_t));
+        select_counts = mmap(NULL, opts.max_workers * sizeof(SelectCounts), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        candidates = arena_take(&arena, ARRAY_SIZE * sizeof(elem_t));
+        bracket = mmap(NULL, 2 * sizeof(elem_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        select_sample = arena_take(&arena, SELECT_SAMPLE * sizeof(elem_t));
+    }
+
+    // Fork workers once, sized for the largest process count, after all
+    // shared memory they use is mapped
+    proc_pool_init(&pool, opts.max_workers);
+
+    // Pin worker i to its CPU, spreading workers over the NUMA nodes
+    if (affinity) {
+        placement_init();
+        for (int i = 0; i < opts.max_workers; i++) {
+            pin_worker(proc_pool_worker_pid(&pool, i), i);
+        }
+        printf(" - Affinity: %d workers over %d CPUs on %d NUMA nodes\n",
+               opts.max_workers, placement.count, placement.nodes);
+    }
+
+    // Counters for the parent (slot 0) and every worker process
+    if (opts.perf) {
+        pid_t pids[opts.max_workers + 1];
+        pids[0] = 0;
+        for (int i = 0; i < opts.max_workers; i++) {
+            pids[i + 1] = proc_pool_worker_pid(&pool, i);
+        }
+        perf_set_open(&perf, pids, opts.max_workers + 1);
+    }
 
     printf("------------------------------------------------------------------------------------------------------------------------\n");
-    int process_count[] = {1, 2, 4, 8}; // Thread configs
-    double performance[4];              // For storing execution times
-    long memory_usage[4];               // For storing memory Usage
+    int *process_count = opts.workers;  // Process configs
+    BenchResult results[MAX_CONFIGS];   // Timing statistics of each config
+    double *samples = malloc(opts.reps * sizeof(double));
+    double *topk_samples = malloc(opts.reps * sizeof(double));
+    double *select_samples = malloc(opts.reps * sizeof(double));
 
     struct timespec c_start, c_end;
+    printf(" - Array: %zu x %s\n", ARRAY_SIZE, ELEM_NAME);
+    printf(" - Scan kernel: %s\n", kernel);
+    if (opts.input != NULL) {
+        printf(" - Input: %s\n", opts.input);
+    } else {
+        printf(" - Input: %s, seed %llu\n", distribution_names[input_dist], (unsigned long long)input_seed);
+    }
+    printf(" - Reduce strategy: %s\n", reduce_name);
+    printf(" - Arena: %zu MB, %s pages%s\n", arena.size >> 20, page_mode_names[arena.pages],
+           opts.prefault ? ", prefaulted" : "");
+    if (top_k > 0) {
+        printf(" - Queries: top %zu, p50, p99\n", top_k);
+    }
 
     // Loop through the different process counts
-    for (int p = 0; p < 4; p++) {
-        *global_max = array[0];
+    for (int p = 0; p < opts.num_configs; p++) {
         NUM_PROCESSES = process_count[p];
+        if ((size_t)NUM_PROCESSES > ARRAY_SIZE) {
+            NUM_PROCESSES = ARRAY_SIZE;     // Every process needs at least one element
+        }
         chunk_size = ARRAY_SIZE / NUM_PROCESSES;
+        proc_pool_set_active(&pool, NUM_PROCESSES);
         if (NUM_PROCESSES == 1){
             printf(" - %d PROCESS:\n", NUM_PROCESSES);
         } else {
             printf(" - %d PROCESSES:\n", NUM_PROCESSES);
         }
 
-        // Generate & Fill Array
-        srand(42);
-        for (int i = 0; i < ARRAY_SIZE; i++) {
-            array[i] = rand() % 100;
+        // Bind each process's chunk to its node before the fill touches it
+        if (affinity && opts.input == NULL) {
+            for (int i = 0; i < NUM_PROCESSES; i++) {
+                size_t start = i * chunk_size;
+                size_t length = (i == NUM_PROCESSES - 1) ? ARRAY_SIZE - start : chunk_size;
+                place_pages(&array[start], length * sizeof(elem_t), worker_node(i));
+            }
+        }
+
+        // Fault the pages in before the timed runs instead of on first touch
+        if (opts.prefault) {
+            clock_gettime(CLOCK_MONOTONIC, &c_start);
+            run_chunks(prefault_chunk);
+            clock_gettime(CLOCK_MONOTONIC, &c_end);
+            printf("    - Prefault: %f sec\n", (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9);
+        }
+
+        // Generate & Fill Array in parallel, which the scan never modifies
+        if (opts.input != NULL) {
+            // Mapped file, already in place
+        } else {
+            run_chunks(fill_chunk);
         }
 
         // Print Array
         printf("    - Array (first 20 elements):\n\t");
-        for (int i = 0; i < 20; i++) {
-            printf("%d ", array[i]);
+        for (size_t i = 0; i < 20 && i < ARRAY_SIZE; i++) {
+            printf(ELEM_FMT " ", ELEM_PRINT(array[i]));
         }
         printf("\n\n");
+        printf("    - Finding Global Max:\n");
 
-        // Record memory and time before execution
-        long mem_before = get_memory_usage();
-        clock_gettime(CLOCK_MONOTONIC, &c_start);
+        // Warmup runs first, then timed runs
+        begin_result(&results[p], NUM_PROCESSES, NUM_PROCESSES);
+        for (int rep = -opts.warmups; rep < opts.reps; rep++) {
+            *global_stats = empty_stats();
+            reset_atomic_stats(atomic_stats);
+            sem_init(mutex, 1, 1);
+            fflush(stdout);
 
-        // ---- Map Phase ------------------------------------------------------
-        // Create processes to process chunks
-        printf("    - Finding Global Max:\n");
-        *global_max = array[0];
-        sem_init(mutex, 1, 1);
-        pid_t pids[NUM_PROCESSES];
-        for (int i = 0; i < NUM_PROCESSES; i++) {
-            pids[i] = fork();
-            if(pids[i] == 0) {
-                find_local_max(i);
-                _exit(0);
+            // Start memory window and time before execution
+            reset_peak_rss();
+            phase_mark(&perf, NUM_PROCESSES + 1, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &c_start);
+
+            // ---- Map Phase --------------------------------------------------
+            // Hands one chunk per process to the worker pool and waits for all
+            if (affinity) {
+                proc_pool_run_pinned(&pool, find_local_max, NUM_PROCESSES);
+            } else {
+                proc_pool_run(&pool, find_local_max, NUM_PROCESSES);
+            }
+            phase_mark(&perf, NUM_PROCESSES + 1, (rep >= 0) ? &results[p].map : NULL);
+
+            // Combine lock-free results
+            if (reduce_mode == REDUCE_SLOTS) {
+                for (int i = 0; i < NUM_PROCESSES; i++) {
+                    combine_stats(global_stats, &worker_stats[i].stats);
+                }
+            } else if (reduce_mode == REDUCE_ATOMIC) {
+                *global_stats = load_atomic_stats(atomic_stats);
+            }
+
+            // Record time and memory after execution
+            clock_gettime(CLOCK_MONOTONIC, &c_end);
+            phase_mark(&perf, NUM_PROCESSES + 1, (rep >= 0) ? &results[p].reduce : NULL);
+            sem_destroy(mutex);
+
+            if (rep >= 0) {
+                // Workers ran the map phase (and the lock / atomic reduce inside it)
+                record_run(&results[p], read_peak_rss_kb(), child_reports);
+                if (affinity) {
+                    record_slices(&results[p], timings, NUM_PROCESSES);
+                }
+                samples[rep] = (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9;
             }
-        }
 
-        // Wait for all child process to finish
-        for (int i = 0; i < NUM_PROCESSES; i++) {
-            waitpid(pids[i], NULL, 0);
+            // Queries run after the scan and are timed apart from it
+            if (top_k > 0) {
+                double topk_seconds, select_seconds;
+                run_queries(&topk_seconds, &select_seconds);
+                if (rep >= 0) {
+                    topk_samples[rep] = topk_seconds;
+                    select_samples[rep] = select_seconds;
+                }
+            }
         }
         printf("\n\t - All processess finished -\n");
 
         // Output Result
-        printf("\n    - Global Max: %d\n", *global_max);
+        printf("\n    - Global Max: " ELEM_FMT " (index %zu)\n", ELEM_PRINT(global_stats->max), global_stats->argmax);
+        printf("    - Global Min: " ELEM_FMT "\n", ELEM_PRINT(global_stats->min));
+        printf("    - Sum: " SUM_FMT "\n", global_stats->sum);
+        if (top_k > 0) {
+            printf("    - Top %zu (first 20):", top_k);
+            for (size_t i = 0; i < 20 && i < top_k; i++) {
+                printf(" " ELEM_FMT, ELEM_PRINT(top_values.items[i]));
+            }
+            printf("\n    - k-th Largest (k = %zu): " ELEM_FMT "\n", top_k, ELEM_PRINT(kth_largest));
+            printf("    - p50: " ELEM_FMT ", p99: " ELEM_FMT "\n", ELEM_PRINT(p50), ELEM_PRINT(p99));
+            printf("    - Query Time: %f sec top-k, %f sec p50 + p99 (medians)\n",
+                   median_seconds(topk_samples, opts.reps), median_seconds(select_samples, opts.reps));
+        }
 
-        // Record memory and time after execution
-        long mem_after = get_memory_usage();
-        clock_gettime(CLOCK_MONOTONIC, &c_end);
+        // Calculate execution time statistics
+        summarize_samples(samples, opts.reps, ARRAY_SIZE, &results[p]);
+        printf("\n    - Execution Time: %f sec (median of %d, p95 %f, stddev %f)",
+               results[p].median, opts.reps, results[p].p95, results[p].stddev);
 
-        // Calculate total memory usage
-        long total_child_mem = 0;
-        for (int i = 0; i < NUM_PROCESSES; i++) {
-            total_child_mem += child_mem[i];
+        // Memory high water marks of parent and children, heap bytes per run
+        printf("\n\n    - Peak RSS: %ld KB (parent), %ld KB (largest child)\n",
+               results[p].peak_rss_kb, results[p].child_peak_kb);
+        if (smaps_enabled) {
+            printf("    - Children: %ld KB PSS, %ld KB USS\n", results[p].child_pss_kb, results[p].child_uss_kb);
         }
-        memory_usage[p] = total_child_mem;
-        printf("\n    - Total memory used by children: %ld KB\n", total_child_mem);
-
-        // Calculate parent memory usage
-        double execution_time = (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9;
-        printf("\n    - Execution Time: %f sec", execution_time);
-        printf("\n\n    - Memory Before: %ld KB\n", mem_before);
-        printf("    - Memory After: %ld KB\n", mem_after);
-        printf("    - Memory Delta: %ld KB", mem_after - mem_before);
+        printf("    - Heap Allocated: %lld B map (children included), %lld B reduce",
+               results[p].map.alloc_bytes, results[p].reduce.alloc_bytes);
+        printf("\n    - Page Faults: %lld map (children included), %lld reduce",
+               results[p].map.faults, results[p].reduce.faults);
 
         printf("\n------------------------------------------------------------------------------------------------------------------------\n");
-        performance[p] = execution_time;
-
     }
 
     // Print performance data for each process count
-    printf("\nPerformance Summary:\n");
-    printf("Processes  Time (s)\tMem Usage (KB)\n");
-    for (int p = 0; p < 4; p++) {
-        printf("%d\t   %.6f\t%ld\n", process_count[p], performance[p], memory_usage[p]);
-    }
+    fflush(stdout);
+    print_report(report, &opts, "max_value_multiprocessing", reduce_name, "Processes", results);
+    free(samples);
+    free(topk_samples);
+    free(select_samples);
 
-    // Destory semaphore and release memory
-    sem_destroy(mutex);
-    munmap(array, ARRAY_SIZE * sizeof(int));
-    munmap(global_max, sizeof(int));
+    // Stop workers and release memory
+    perf_set_close(&perf);
+    proc_pool_destroy(&pool);
+    if (opts.input != NULL) {
+        munmap(array, ARRAY_SIZE * sizeof(elem_t));
+    }
+    arena_release(&arena);
+    munmap(global_stats, sizeof(ChunkStats));
     munmap(mutex, sizeof(sem_t));
-    munmap(child_mem, 8 * sizeof(long));
+    munmap(worker_stats, opts.max_workers * sizeof(PaddedStats));
+    munmap(atomic_stats, sizeof(AtomicStats));
+    munmap(child_reports, opts.max_workers * sizeof(ChildReport));
+    munmap(timings, opts.max_workers * sizeof(SliceTiming));
+    if (top_k > 0) {
+        munmap(worker_heaps, opts.max_workers * sizeof(TopK));
+        munmap(select_counts, opts.max_workers * sizeof(SelectCounts));
+        munmap(bracket, 2 * sizeof(elem_t));
+    }
     return 0;
 }
@@ -3,156 +3,578 @@
 #include <pthread.h>
 #include <time.h>
 #include <string.h>
+#include <limits.h>
+#include "max_kernels.h"
+#include "select_kernels.h"
+#include "range_index.h"
+#include "thread_pool.h"
+#include "bench_options.h"
+#include "bench_report.h"
+#include "arena.h"
 
-// Array Size
-#define ARRAY_SIZE 131072
+#define SCAN_GRAIN 8192             // Elements per scan task, many tasks per thread
+#define RANGE_PARALLEL_ENTRIES 4096 // Smaller index levels are summarized by one thread
+#define RANGE_CHECKS 64             // Random ranges compared against the scan kernel
+#define RANGE_SEED 0x4A4E6Eu        // Stream of the random query ranges
 
 // Global Variables
-int array[ARRAY_SIZE];
-int chunk_size;
+elem_t *array;
+size_t ARRAY_SIZE;                  // Set by -n
+int num_chunks;                     // Scan tasks per config, ARRAY_SIZE / SCAN_GRAIN rounded up
 pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-int global_max;
+ChunkStats global_stats;            // Max, min, sum and argmax of whole array
 int NUM_THREADS;
+ThreadPool pool;                    // Workers reused by every config
+int reduce_mode;                    // REDUCE_LOCK, REDUCE_SLOTS or REDUCE_ATOMIC
+int verbose;                        // Per-chunk progress lines (-v)
+PerfSet perf;                       // Counters of main thread and workers (-p)
+PaddedStats *worker_stats;          // One result slot per chunk (slots mode)
+AtomicStats atomic_stats;           // Lock-free global result (atomic mode)
+int affinity;                       // One pinned slice per thread instead of stolen chunks (-a)
+SliceTiming *timings;               // Scan time of each thread's slice (affinity mode)
+int input_dist;                     // DIST_* of the generated array (-d)
+uint64_t input_seed;                // Generator seed (-s)
+Arena arena;                        // Holds array, reduce slots and query buffers (-H)
 
-// Returns current memory usage by program
-long get_memory_usage() {
-    FILE* fp = fopen("/proc/self/status", "r");
-    if (fp == NULL) {
-        perror("Error opening /proc/self/status");
-        return 0;
-    }
-    char line[256];
-    long vm_rss = -1;
-
-    // Scan file until VmRSS field is found
-    while (fgets(line, sizeof(line), fp) != NULL) {
-        if (strncmp(line, "VmRSS:", 6) == 0) {
-            sscanf(line + 6, "%ld", &vm_rss);
-            break;
-        }
-    }
+// Query Variables (-k)
+size_t top_k;                       // Values of the top-k query, 0 for no queries
+TopK *worker_heaps;                 // Bounded heap of each thread's slice
+elem_t *heap_items;                 // top_k slots per thread
+TopK top_values;                    // Merged heap, sorted largest first after the reduce
+elem_t kth_largest;                 // Smallest of the top k
+elem_t p50, p99;                    // Percentiles from select_rank()
+SelectCounts *select_counts;        // Pass counts of each thread's slice
+elem_t *candidates;                 // Elements inside the bracket, at their slice's offset
+elem_t *select_sample;              // Scratch for select_bracket()
+elem_t select_low, select_high;     // Bracket of the current pass
 
-    fclose(fp);
-    return vm_rss;
+// Range Index Variables (-q)
+size_t range_queries;               // Random range queries per thread, 0 for no index
+RangeIndex range;                   // Summaries over array, rebuilt every run
+int build_level;                    // Level being summarized by build_slice()
+PaddedStats *query_sinks;           // Fold of each thread's query results
+
+// First index of thread t's slice in affinity mode; the last slice takes the remainder
+size_t slice_start(int t) {
+    return (t < NUM_THREADS) ? t * (ARRAY_SIZE / NUM_THREADS) : ARRAY_SIZE;
+}
+
+// Fills thread id's slice of array; every element depends only on its index,
+// so the array is the same for any thread count
+void* fill_slice(void* arg) {
+    int id = *(int *)arg;
+    generate_range(array, slice_start(id), slice_start(id + 1), ARRAY_SIZE, input_dist, input_seed);
+    return NULL;
+}
+
+// Faults in thread id's slices of array and of the query candidates before
+// the timed runs (-P); in affinity mode on the worker that scans them
+void* prefault_slice(void* arg) {
+    int id = *(int *)arg;
+    size_t start = slice_start(id);
+    size_t bytes = (slice_start(id + 1) - start) * sizeof(elem_t);
+    if (arena_owns(&arena, array)) {
+        prefault(&array[start], bytes);
+    }
+    if (candidates != NULL) {
+        prefault(&candidates[start], bytes);
+    }
+    return NULL;
 }
 
 // Computes maximum value within assigned chunk
+// Chunks are small and outnumber threads, so idle workers pick up the rest;
+// in affinity mode chunk id is instead thread id's slice, on its own node
 void* find_local_max(void* arg) {
     int id = *(int *)arg;
-    free(arg);
+    struct timespec t_start, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+
+    // Determine start and length of chunk
+    size_t start = affinity ? slice_start(id) : (size_t)id * SCAN_GRAIN;
+    size_t length = affinity ? slice_start(id + 1) - start
+                             : ((start + SCAN_GRAIN < ARRAY_SIZE) ? SCAN_GRAIN : ARRAY_SIZE - start);
 
-    // Determine start and end for thread chunk
-    int start = id * chunk_size;
-    int end = 0;
-    if (id == NUM_THREADS - 1) {
-        end = ARRAY_SIZE - 1;
+    if (verbose) {
+        printf("\tChunk %d: Finding local max in %zu to %zu\n", id, start, start + length - 1);
+        fflush(stdout);
+    }
+
+    // Compute local max, min, sum and argmax in one pass
+    // Slices are empty when threads outnumber elements
+    ChunkStats local = empty_stats();
+    if (length > 0) {
+        local = affinity ? scan_range(&array[start], length) : scan_chunk(&array[start], length);
+        local.argmax += start;
+    }
+
+    // ---- Reduce Phase -------------------------------------------------------
+    if (reduce_mode == REDUCE_SLOTS) {
+        // Own slot, combined by main thread after join
+        worker_stats[id].stats = local;
+    } else if (reduce_mode == REDUCE_ATOMIC) {
+        // Lock-free update of global stats
+        atomic_combine_stats(&atomic_stats, &local);
     } else {
-        end = start + chunk_size - 1;
+        // Updates global stats protected with mutex
+        pthread_mutex_lock(&mutex);
+        combine_stats(&global_stats, &local);
+        pthread_mutex_unlock(&mutex);
     }
 
-    printf("\tThread %d: Finding local max in %d to %d\n", id, start, end);
-    fflush(stdout);
+    if (affinity) {
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+        timings[id].seconds = (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+        timings[id].bytes = length * sizeof(elem_t);
+    }
+    return NULL;
+}
+
+// Loop body of the map phase: workers claim chunk ids from pool_for()'s
+// counter instead of receiving one task each
+void scan_claimed_chunk(long chunk, void* arg) {
+    find_local_max(&((int *)arg)[chunk]);
+}
+
+// Runs fn once per thread slice; in affinity mode slice t runs on worker t,
+// whose node holds its pages
+void run_slices(task_fn fn, int *ids) {
+    if (affinity) {
+        pool_run_pinned(&pool, fn, ids, NUM_THREADS);
+    } else {
+        pool_run(&pool, fn, ids, NUM_THREADS);
+    }
+}
+
+// Top-k task: offers a thread's slice to its own bounded heap
+void* topk_slice(void* arg) {
+    int id = *(int *)arg;
+    topk_init(&worker_heaps[id], top_k, &heap_items[(size_t)id * top_k]);
+    topk_scan(&worker_heaps[id], &array[slice_start(id)], slice_start(id + 1) - slice_start(id));
+    return NULL;
+}
+
+// Order statistic task: counts a thread's slice against the bracket and
+// copies the elements inside it to the same offset of candidates
+void* select_slice(void* arg) {
+    int id = *(int *)arg;
+    size_t start = slice_start(id);
+    select_scan(&array[start], slice_start(id + 1) - start, select_low, select_high, &select_counts[id],
+                &candidates[start]);
+    return NULL;
+}
 
-    // Compute local max
-    int local_max = array[start];
-    for (int i = start + 1; i <= end; i++) {
-        if (array[i] > local_max) {
-            local_max = array[i];
+// Element of rank r: one pass over all slices, and a second one in the rare
+// case that the sampled bracket missed r
+elem_t select_rank(size_t r, int *ids) {
+    select_bracket(array, ARRAY_SIZE, r, select_sample, &select_low, &select_high);
+    SelectCounts total;
+    elem_t result;
+    do {
+        run_slices(select_slice, ids);
+
+        // Gather the elements inside the bracket at the front of candidates
+        total = (SelectCounts){0};
+        for (int t = 0; t < NUM_THREADS; t++) {
+            memmove(&candidates[total.inside], &candidates[slice_start(t)], select_counts[t].inside * sizeof(elem_t));
+            select_add(&total, &select_counts[t]);
         }
+    } while (!select_resolve(&total, candidates, r, global_stats.min, global_stats.max,
+                             &select_low, &select_high, &result));
+    return result;
+}
+
+// Answers the -k queries on the scanned array: per-thread heaps merged into
+// the top k, then p50 and p99; stores the seconds each part took
+void run_queries(int *ids, double *topk_seconds, double *select_seconds) {
+    struct timespec t_start, t_heaps, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    run_slices(topk_slice, ids);
+    topk_init(&top_values, top_k, top_values.items);
+    for (int t = 0; t < NUM_THREADS; t++) {
+        topk_merge(&top_values, &worker_heaps[t]);
     }
+    kth_largest = top_values.items[0];
+    topk_sort(&top_values);
+    clock_gettime(CLOCK_MONOTONIC, &t_heaps);
 
-    // ---- Reduce Phase -------------------------------------------------------
-    // Updates global max protected with mutex
-    pthread_mutex_lock(&mutex);
-    if (local_max > global_max) {
-        global_max = local_max;
+    p50 = select_rank(percentile_rank(ARRAY_SIZE, 50), ids);
+    p99 = select_rank(percentile_rank(ARRAY_SIZE, 99), ids);
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+    *topk_seconds = (t_heaps.tv_sec - t_start.tv_sec) + (t_heaps.tv_nsec - t_start.tv_nsec) / 1e9;
+    *select_seconds = (t_end.tv_sec - t_heaps.tv_sec) + (t_end.tv_nsec - t_heaps.tv_nsec) / 1e9;
+}
+
+// Index build task: a thread's share of the summaries of build_level
+void* build_slice(void* arg) {
+    int id = *(int *)arg;
+    size_t entries = range.size[build_level];
+    range_summarize(&range, build_level, entries * id / NUM_THREADS, entries * (id + 1) / NUM_THREADS);
+    return NULL;
+}
+
+// Builds the range index bottom up; each level needs the one below complete,
+// so a level is one pool run, and small levels are left to the main thread
+void build_range_index(int *ids) {
+    for (build_level = 1; build_level <= range.levels; build_level++) {
+        if (range.size[build_level] < RANGE_PARALLEL_ENTRIES) {
+            range_summarize(&range, build_level, 0, range.size[build_level]);
+        } else {
+            run_slices(build_slice, ids);
+        }
     }
-    pthread_mutex_unlock(&mutex);
+}
+
+// Random range number q of stream id, lo <= hi
+void random_range(int id, size_t q, size_t *lo, size_t *hi) {
+    size_t a = counter_random(RANGE_SEED + id, 2 * q) % ARRAY_SIZE;
+    size_t b = counter_random(RANGE_SEED + id, 2 * q + 1) % ARRAY_SIZE;
+    *lo = (a < b) ? a : b;
+    *hi = (a < b) ? b : a;
+}
 
-    pthread_exit(NULL);
+// Query task: range_queries random ranges of the thread's own stream, folded
+// into its sink so none of them can be optimized away
+void* query_slice(void* arg) {
+    int id = *(int *)arg;
+    ChunkStats sink = empty_stats();
+    for (size_t q = 0; q < range_queries; q++) {
+        size_t lo, hi;
+        random_range(id, q, &lo, &hi);
+        RangeResult result = range_query(&range, lo, hi);
+        sink.max = (result.max > sink.max) ? result.max : sink.max;
+        sink.min = (result.min < sink.min) ? result.min : sink.min;
+    }
+    query_sinks[id].stats = sink;
+    return NULL;
+}
+
+// Times count point update pairs on the main thread: a random element takes
+// another one's value, then gets its own back, leaving array unchanged
+double time_range_updates(size_t count) {
+    struct timespec t_start, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    for (size_t q = 0; q < count; q++) {
+        size_t i, j;
+        random_range(-1, q, &i, &j);
+        elem_t old = array[i];
+        range_update(&range, i, array[j]);
+        range_update(&range, i, old);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    return (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+}
+
+// Compares the index with the scan kernel on the whole array and on
+// RANGE_CHECKS random ranges, returns the number of mismatches
+int check_range_index(void) {
+    int mismatches = 0;
+    for (int q = 0; q <= RANGE_CHECKS; q++) {
+        size_t lo = 0, hi = ARRAY_SIZE - 1;
+        if (q < RANGE_CHECKS) {
+            random_range(-2, q, &lo, &hi);
+        }
+        RangeResult result = range_query(&range, lo, hi);
+        ChunkStats scan = scan_range(&array[lo], hi - lo + 1);
+        mismatches += (result.max != scan.max || result.min != scan.min);
+    }
+    return mismatches;
 }
 
 // Main Method
-int main(void) {
+int main(int argc, char *argv[]) {
+    // Pick SIMD scan kernel for this CPU
+    const char *kernel = select_scan_kernel();
+
+    // Array size, thread counts and reduce strategy: lock (default), slots or atomic
+    Options opts;
+    if (parse_options(argc, argv, &opts, "[lock|slots|atomic]") != 0) {
+        return 1;
+    }
+    const char *reduce_name = opts.mode ? opts.mode : "lock";
+    reduce_mode = parse_reduce_mode(reduce_name);
+    if (reduce_mode < 0) {
+        fprintf(stderr, "Unknown reduce strategy '%s' (expected lock, slots or atomic)\n", reduce_name);
+        return 1;
+    }
+
+    verbose = opts.verbose;
+    affinity = opts.affinity;
+    input_dist = opts.dist;
+    input_seed = opts.seed;
+    FILE *report = open_report(&opts);
+
     printf("------------------------------------------------------------------------------------------------------------------------\n");
-    int thread_count[] = {1, 2, 4, 8};  // Thread configs
-    double performance[4];              // For storing execution times
-    long memory_usage[4];               // For storing memory usage
+    int *thread_count = opts.workers;   // Thread configs
+    BenchResult results[MAX_CONFIGS];   // Timing statistics of each config
+    double *samples = malloc(opts.reps * sizeof(double));
+    double *topk_samples = malloc(opts.reps * sizeof(double));
+    double *select_samples = malloc(opts.reps * sizeof(double));
+    double *build_samples = malloc(opts.reps * sizeof(double));
+    double *query_samples = malloc(opts.reps * sizeof(double));
+    double *update_samples = malloc(opts.reps * sizeof(double));
+
+    // A -i file is scanned where it lies in the page cache
+    if (opts.input != NULL) {
+        array = map_file(opts.input, sizeof(elem_t), &ARRAY_SIZE, 0);
+        opts.n = ARRAY_SIZE;
+    } else {
+        ARRAY_SIZE = opts.n;
+    }
+    num_chunks = (ARRAY_SIZE + SCAN_GRAIN - 1) / SCAN_GRAIN;
+    int max_tasks = (num_chunks > opts.max_workers) ? num_chunks : opts.max_workers;
+    top_k = (opts.top_k < ARRAY_SIZE) ? opts.top_k : ARRAY_SIZE;
+
+    // One arena holds the generated array, the reduce slots of the most tasks,
+    // the -k query buffers and heaps and the -q range index summaries;
+    // candidates are only touched as far as they fill
+    size_t array_elems = (opts.input == NULL) ? ARRAY_SIZE : 0;
+    size_t query_elems = (top_k > 0) ? ARRAY_SIZE + (size_t)(opts.max_workers + 1) * top_k + SELECT_SAMPLE : 0;
+    size_t query_bytes = (top_k > 0) ? opts.max_workers * (sizeof(SelectCounts) + sizeof(TopK)) : 0;
+    size_t range_bytes = (opts.range_queries > 0) ? range_index_arena_bytes(ARRAY_SIZE) : 0;
+    arena_reserve(&arena, (array_elems + query_elems) * sizeof(elem_t) + max_tasks * sizeof(PaddedStats) +
+                  query_bytes + range_bytes + 8 * HUGE_PAGE_SIZE, 0, opts.pages);
+    if (array_elems > 0) {
+        array = arena_take(&arena, array_elems * sizeof(elem_t));
+    }
+    worker_stats = arena_take(&arena, max_tasks * sizeof(PaddedStats));
+    int *chunk_ids = malloc(max_tasks * sizeof(int));
+    for (int i = 0; i < max_tasks; i++) {
+        chunk_ids[i] = i;
+    }
 
     struct timespec c_start, c_end;
+    printf(" - Array: %zu x %s\n", ARRAY_SIZE, ELEM_NAME);
+    printf(" - Scan kernel: %s\n", kernel);
+    if (opts.input != NULL) {
+        printf(" - Input: %s\n", opts.input);
+    } else {
+        printf(" - Input: %s, seed %llu\n", distribution_names[input_dist], (unsigned long long)input_seed);
+    }
+    printf(" - Reduce strategy: %s\n", reduce_name);
+    printf(" - Arena: %zu MB, %s pages%s\n", arena.size >> 20, page_mode_names[arena.pages],
+           opts.prefault ? ", prefaulted" : "");
+
+    // Query buffers
+    if (top_k > 0) {
+        worker_heaps = arena_take(&arena, opts.max_workers * sizeof(TopK));
+        heap_items = arena_take(&arena, (size_t)opts.max_workers * top_k * sizeof(elem_t));
+        top_values.items = arena_take(&arena, top_k * sizeof(elem_t));
+        select_counts = arena_take(&arena, opts.max_workers * sizeof(SelectCounts));
+        candidates = arena_take(&arena, ARRAY_SIZE * sizeof(elem_t));
+        select_sample = arena_take(&arena, SELECT_SAMPLE * sizeof(elem_t));
+        printf(" - Queries: top %zu, p50, p99\n", top_k);
+    }
+
+    // Range index over array; a read-only -i mapping gets no updates
+    range_queries = opts.range_queries;
+    if (range_queries > 0) {
+        range_index_init(&range, array, ARRAY_SIZE, &arena);
+        query_sinks = aligned_alloc(CACHE_LINE, opts.max_workers * sizeof(PaddedStats));
+        printf(" - Range index: %zu queries per thread, %zu updates%s\n", range_queries,
+               (opts.input != NULL) ? (size_t)0 : 2 * range_queries, (opts.input != NULL) ? " (read-only -i)" : "");
+    }
+
+    // Start workers once, sized for the largest thread count
+    pool_init(&pool, opts.max_workers);
+
+    // Pin worker i to its CPU, spreading workers over the NUMA nodes
+    if (affinity) {
+        placement_init();
+        for (int i = 0; i < opts.max_workers; i++) {
+            pin_worker(pool_worker_tid(&pool, i), i);
+        }
+        timings = aligned_alloc(CACHE_LINE, opts.max_workers * sizeof(SliceTiming));
+        printf(" - Affinity: %d workers over %d CPUs on %d NUMA nodes\n",
+               opts.max_workers, placement.count, placement.nodes);
+    }
+
+    // Counters for main thread (slot 0) and every worker
+    if (opts.perf) {
+        pid_t tids[opts.max_workers + 1];
+        tids[0] = 0;
+        for (int i = 0; i < opts.max_workers; i++) {
+            tids[i + 1] = pool_worker_tid(&pool, i);
+        }
+        perf_set_open(&perf, tids, opts.max_workers + 1);
+    }
 
     // Loop through the different thread counts
-    for (int t = 0; t < 4; t++) {
+    for (int t = 0; t < opts.num_configs; t++) {
         NUM_THREADS = thread_count[t];
-        chunk_size = ARRAY_SIZE / NUM_THREADS;
+        pool_set_active(&pool, NUM_THREADS);
         if (NUM_THREADS == 1){
             printf(" - %d THREAD:\n", NUM_THREADS);
         } else {
             printf(" - %d THREADS:\n", NUM_THREADS);
         }
 
-        // Generate & Fill Array
-        srand(42);
-        for (int i = 0; i < ARRAY_SIZE; i++) {
-            array[i] = rand() % 100;
+        // Bind each thread's slice to its node before the fill touches it
+        if (affinity && opts.input == NULL) {
+            for (int i = 0; i < NUM_THREADS; i++) {
+                place_pages(&array[slice_start(i)], (slice_start(i + 1) - slice_start(i)) * sizeof(elem_t),
+                            worker_node(i));
+            }
+        }
+
+        // Fault the pages in before the timed runs instead of on first touch
+        if (opts.prefault) {
+            long long faults = page_faults();
+            clock_gettime(CLOCK_MONOTONIC, &c_start);
+            run_slices(prefault_slice, chunk_ids);
+            clock_gettime(CLOCK_MONOTONIC, &c_end);
+            printf("    - Prefault: %f sec, %lld page faults\n",
+                   (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9, page_faults() - faults);
+        }
+
+        // Generate & Fill Array in parallel, which the scan never modifies
+        if (opts.input == NULL) {
+            run_slices(fill_slice, chunk_ids);
         }
 
         // Print Array
         printf("    - Array (first 20 elements):\n\t");
-        for (int i = 0; i < 20; i++) {
-            printf("%d ", array[i]);
+        for (size_t i = 0; i < 20 && i < ARRAY_SIZE; i++) {
+            printf(ELEM_FMT " ", ELEM_PRINT(array[i]));
         }
         printf("\n\n");
+        printf("    - Finding Global Max:\n");
+        fflush(stdout);
 
-        // Record memory and time before execution
-        long mem_before = get_memory_usage();
-        clock_gettime(CLOCK_MONOTONIC, &c_start);
+        // Warmup runs first, then timed runs
+        begin_result(&results[t], NUM_THREADS, 0);
+        for (int rep = -opts.warmups; rep < opts.reps; rep++) {
+            // Start memory window and time before execution
+            reset_peak_rss();
+            phase_mark(&perf, NUM_THREADS + 1, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &c_start);
 
-        // ---- Map Phase ------------------------------------------------------
-        // Creates threads to process chunks
-        printf("    - Finding Global Max:\n");
-        global_max = array[0];
-        pthread_t threads[NUM_THREADS];
-        for (int i = 0; i < NUM_THREADS; i++) {
-            int *arg = malloc(sizeof(int));
-            *arg = i;
-            pthread_create(&threads[i], NULL, find_local_max, arg);
-        }
+            // ---- Map Phase --------------------------------------------------
+            // NUM_THREADS workers claim chunks until none are left, or each
+            // worker scans its own slice in affinity mode
+            int tasks = affinity ? NUM_THREADS : num_chunks;
+            global_stats = empty_stats();
+            reset_atomic_stats(&atomic_stats);
 
-        // Wait for all threads to complete
-        for (int i = 0; i < NUM_THREADS; i++) {
-            pthread_join(threads[i], NULL);
+            // Wait for all tasks to complete
+            if (affinity) {
+                pool_run_pinned(&pool, find_local_max, chunk_ids, tasks);
+            } else {
+                pool_for(&pool, tasks, scan_claimed_chunk, chunk_ids);
+            }
+            phase_mark(&perf, NUM_THREADS + 1, (rep >= 0) ? &results[t].map : NULL);
+
+            // Combine lock-free results
+            if (reduce_mode == REDUCE_SLOTS) {
+                for (int i = 0; i < tasks; i++) {
+                    combine_stats(&global_stats, &worker_stats[i].stats);
+                }
+            } else if (reduce_mode == REDUCE_ATOMIC) {
+                global_stats = load_atomic_stats(&atomic_stats);
+            }
+
+            // Record time and memory after execution
+            clock_gettime(CLOCK_MONOTONIC, &c_end);
+            phase_mark(&perf, NUM_THREADS + 1, (rep >= 0) ? &results[t].reduce : NULL);
+
+            if (rep >= 0) {
+                record_run(&results[t], read_peak_rss_kb(), NULL);
+                if (affinity) {
+                    record_slices(&results[t], timings, NUM_THREADS);
+                }
+                samples[rep] = (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9;
+            }
+
+            // Queries run after the scan and are timed apart from it
+            if (top_k > 0) {
+                double topk_seconds, select_seconds;
+                run_queries(chunk_ids, &topk_seconds, &select_seconds);
+                if (rep >= 0) {
+                    topk_samples[rep] = topk_seconds;
+                    select_samples[rep] = select_seconds;
+                }
+            }
+
+            // Range index: parallel build, queries from every thread, then
+            // updates from the main thread
+            if (range_queries > 0) {
+                struct timespec t_start, t_built, t_end;
+                clock_gettime(CLOCK_MONOTONIC, &t_start);
+                build_range_index(chunk_ids);
+                clock_gettime(CLOCK_MONOTONIC, &t_built);
+                run_slices(query_slice, chunk_ids);
+                clock_gettime(CLOCK_MONOTONIC, &t_end);
+                double update_seconds = (opts.input != NULL) ? 0 : time_range_updates(range_queries);
+                if (rep >= 0) {
+                    build_samples[rep] = (t_built.tv_sec - t_start.tv_sec) + (t_built.tv_nsec - t_start.tv_nsec) / 1e9;
+                    query_samples[rep] = (t_end.tv_sec - t_built.tv_sec) + (t_end.tv_nsec - t_built.tv_nsec) / 1e9;
+                    update_samples[rep] = update_seconds;
+                }
+            }
         }
         printf("\n\t - All threads finished -\n");
 
         // Output Resutl
-        printf("\n    - Global Max: %d\n", global_max);
-
-        // Record memory and time after execution
-        clock_gettime(CLOCK_MONOTONIC, &c_end);
-        long mem_after = get_memory_usage();
+        printf("\n    - Global Max: " ELEM_FMT " (index %zu)\n", ELEM_PRINT(global_stats.max), global_stats.argmax);
+        printf("    - Global Min: " ELEM_FMT "\n", ELEM_PRINT(global_stats.min));
+        printf("    - Sum: " SUM_FMT "\n", global_stats.sum);
+        if (top_k > 0) {
+            printf("    - Top %zu (first 20):", top_k);
+            for (size_t i = 0; i < 20 && i < top_k; i++) {
+                printf(" " ELEM_FMT, ELEM_PRINT(top_values.items[i]));
+            }
+            printf("\n    - k-th Largest (k = %zu): " ELEM_FMT "\n", top_k, ELEM_PRINT(kth_largest));
+            printf("    - p50: " ELEM_FMT ", p99: " ELEM_FMT "\n", ELEM_PRINT(p50), ELEM_PRINT(p99));
+            printf("    - Query Time: %f sec top-k, %f sec p50 + p99 (medians)\n",
+                   median_seconds(topk_samples, opts.reps), median_seconds(select_samples, opts.reps));
+        }
+        if (range_queries > 0) {
+            int mismatches = check_range_index();
+            double update_seconds = median_seconds(update_samples, opts.reps);
+            printf("    - Range Index: %d levels, %zu KB, built in %f sec (median), %s\n", range.levels,
+                   range_index_bytes(&range) / 1024, median_seconds(build_samples, opts.reps),
+                   (mismatches == 0) ? "matches the scan" : "MISMATCHES the scan");
+            printf("    - Range Queries: %.2f Mqueries/s over %d threads, %.2f Mupdates/s on one\n",
+                   range_queries * NUM_THREADS / median_seconds(query_samples, opts.reps) / 1e6, NUM_THREADS,
+                   (update_seconds > 0) ? 2 * range_queries / update_seconds / 1e6 : 0.0);
+        }
 
-        // Calculate exeuction time
-        double execution_time = (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9;
-        printf("\n    - Execution Time: %f sec", execution_time);
-        performance[t] = execution_time;
+        // Calculate exeuction time statistics
+        summarize_samples(samples, opts.reps, ARRAY_SIZE, &results[t]);
+        printf("\n    - Execution Time: %f sec (median of %d, p95 %f, stddev %f)",
+               results[t].median, opts.reps, results[t].p95, results[t].stddev);
 
-        // Caluclate memory usage
-        memory_usage[t] = mem_after - mem_before;
-        printf("\n\n    - Memory Before: %ld KB\n", mem_before);
-        printf("    - Memory After: %ld KB\n", mem_after);
-        printf("    - Memory Delta: %ld KB", mem_after - mem_before);
+        // Memory high water mark and heap bytes allocated per run
+        printf("\n\n    - Peak RSS: %ld KB\n", results[t].peak_rss_kb);
+        printf("    - Heap Allocated: %lld B map, %lld B reduce",
+               results[t].map.alloc_bytes, results[t].reduce.alloc_bytes);
+        printf("\n    - Page Faults: %lld map, %lld reduce", results[t].map.faults, results[t].reduce.faults);
 
         printf("\n------------------------------------------------------------------------------------------------------------------------\n");
     }
+    perf_set_close(&perf);
+    pool_destroy(&pool);
     pthread_mutex_destroy(&mutex); // Destory mutex for all threads
+    free(chunk_ids);
+    free(timings);
+    free(samples);
+    free(topk_samples);
+    free(select_samples);
+    free(build_samples);
+    free(query_samples);
+    free(update_samples);
+    if (range_queries > 0) {
+        free(query_sinks);
+    }
+    if (opts.input != NULL) {
+        munmap(array, ARRAY_SIZE * sizeof(elem_t));
+    }
+    arena_release(&arena);
 
     // Print performance summary for all threads
-    printf("\nPerformance Summary:\n");
-    printf("Thread\t   Time (s)\tMem Delta (KB)\n");
-    for (int t = 0; t < 4; t++) {
-        printf("%d\t   %.6f\t%ld\n", thread_count[t], performance[t], memory_usage[t]);
-    }
+    fflush(stdout);
+    print_report(report, &opts, "max_value_multithreading", reduce_name, "Threads", results);
 
     return 0;
 }
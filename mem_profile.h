@@ -0,0 +1,160 @@
+#ifndef MEM_PROFILE_H
+#define MEM_PROFILE_H
+
+// Memory accounting shared by all programs
+//  - Peak RSS is VmHWM, reset before every run through /proc/self/clear_refs
+//    (getrusage's lifetime maximum is used if the reset is refused)
+//  - PSS and USS come from /proc/self/smaps_rollup, so pages a forked child
+//    shares with its parent and siblings are split instead of counted per child
+//  - Page faults (minor + major) come from getrusage, so they are counted
+//    without -p; a process's total covers all of its threads
+//  - Heap bytes are counted by the malloc family wrappers below, which forward
+//    to glibc; read heap_allocated_bytes() at phase boundaries for per-phase totals
+// The wrappers replace the libc symbols, so include this from one file only.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <sys/resource.h>
+
+// Memory figures of one process, -1 where unavailable
+typedef struct {
+    long peak_rss_kb;       // VmHWM
+    long pss_kb;            // Proportional set size, shared pages split among sharers
+    long uss_kb;            // Unique set size, Private_Clean + Private_Dirty
+} MemUsage;
+
+// Returns the kB value of field (e.g. "VmHWM:") in a /proc file, -1 if missing
+static inline long read_proc_kb(const char *path, const char *field) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    char line[256];
+    long value = -1;
+    size_t length = strlen(field);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, field, length) == 0) {
+            sscanf(line + length, "%ld", &value);
+            break;
+        }
+    }
+    fclose(fp);
+    return value;
+}
+
+static int peak_reset_works = 1;    // Cleared once clear_refs is refused
+
+// Starts a new peak RSS window at the current RSS
+static inline void reset_peak_rss(void) {
+    if (!peak_reset_works) {
+        return;
+    }
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (fp == NULL || fputs("5", fp) < 0 || fclose(fp) != 0) {
+        peak_reset_works = 0;
+    }
+}
+
+// Peak RSS since the last reset_peak_rss(), or since start if resets fail
+static inline long read_peak_rss_kb(void) {
+    long peak = read_proc_kb("/proc/self/status", "VmHWM:");
+    if (peak < 0 || !peak_reset_works) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        peak = usage.ru_maxrss;
+    }
+    return peak;
+}
+
+// Page faults of the calling process so far, minor and major
+static inline long long page_faults(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (long long)usage.ru_minflt + usage.ru_majflt;
+}
+
+// Fills usage for the calling process; PSS / USS walk every page table, so
+// they are only read when detailed is set
+static inline void read_mem_usage(MemUsage *usage, int detailed) {
+    usage->peak_rss_kb = read_peak_rss_kb();
+    usage->pss_kb = -1;
+    usage->uss_kb = -1;
+    if (detailed) {
+        usage->pss_kb = read_proc_kb("/proc/self/smaps_rollup", "Pss:");
+        long clean = read_proc_kb("/proc/self/smaps_rollup", "Private_Clean:");
+        long dirty = read_proc_kb("/proc/self/smaps_rollup", "Private_Dirty:");
+        if (clean >= 0 && dirty >= 0) {
+            usage->uss_kb = clean + dirty;
+        }
+    }
+}
+
+// ---- Interposed Allocator ---------------------------------------------------
+// Counts requested bytes of every allocation made by this process
+
+static _Atomic long long heap_bytes;
+
+static inline long long heap_allocated_bytes(void) {
+    return atomic_load_explicit(&heap_bytes, memory_order_relaxed);
+}
+
+static inline void count_allocation(void *memory, size_t size) {
+    if (memory != NULL) {
+        atomic_fetch_add_explicit(&heap_bytes, (long long)size, memory_order_relaxed);
+    }
+}
+
+#if defined(__GLIBC__)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *memory, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *memory);
+
+void *malloc(size_t size) {
+    void *memory = __libc_malloc(size);
+    count_allocation(memory, size);
+    return memory;
+}
+
+void *calloc(size_t count, size_t size) {
+    void *memory = __libc_calloc(count, size);
+    count_allocation(memory, count * size);
+    return memory;
+}
+
+void *realloc(void *memory, size_t size) {
+    void *resized = __libc_realloc(memory, size);
+    count_allocation(resized, size);
+    return resized;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    void *memory = __libc_memalign(alignment, size);
+    count_allocation(memory, size);
+    return memory;
+}
+
+void *memalign(size_t alignment, size_t size) {
+    void *memory = __libc_memalign(alignment, size);
+    count_allocation(memory, size);
+    return memory;
+}
+
+int posix_memalign(void **memory, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    *memory = __libc_memalign(alignment, size);
+    count_allocation(*memory, size);
+    return (*memory == NULL) ? ENOMEM : 0;
+}
+
+void free(void *memory) {
+    __libc_free(memory);
+}
+#endif
+
+#endif
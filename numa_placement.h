@@ -0,0 +1,142 @@
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+// CPU pinning and NUMA page placement for affinity mode (-a)
+// Worker w is pinned to one CPU, consecutive workers alternating between
+// nodes, and the pages of the slice it owns are bound to that CPU's node.
+// Binding sets the policy before the fill loop first touches the pages and
+// migrates pages already touched when a new worker count moves the slices.
+// A hybrid worker process is tied to a node instead, and its threads are
+// pinned to that node's CPUs.
+// Topology comes from sysfs and the raw syscalls, so there is no libnuma
+// dependency; on a single node placement is a no-op and only pinning remains.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#define MAX_NODES 64
+#define MAX_CPUS 1024
+
+static struct {
+    int count;                      // CPUs this process may run on, 0 before placement_init()
+    int cpu[MAX_CPUS];              // Worker w runs on cpu[w % count]
+    int node[MAX_CPUS];             // NUMA node of cpu[i]
+    int nodes;                      // Highest node number + 1
+} placement;
+
+// Node of cpu from /sys/devices/system/cpu/cpuN/nodeM, 0 if unknown
+static inline int cpu_node(int cpu) {
+    char path[64];
+    for (int node = 0; node < MAX_NODES; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) {
+            return node;
+        }
+    }
+    return 0;
+}
+
+// Orders the allowed CPUs round-robin over their nodes
+static inline void placement_init(void) {
+    unsigned long mask[MAX_CPUS / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    if (syscall(SYS_sched_getaffinity, 0, sizeof(mask), mask) < 0) {
+        mask[0] = 1;
+    }
+
+    // Group CPUs by node
+    static int by_node[MAX_NODES][MAX_CPUS];
+    int per_node[MAX_NODES] = {0};
+    placement.nodes = 1;
+    for (int cpu = 0; cpu < MAX_CPUS; cpu++) {
+        if (mask[cpu / (8 * sizeof(unsigned long))] & (1ul << (cpu % (8 * sizeof(unsigned long))))) {
+            int node = cpu_node(cpu);
+            by_node[node][per_node[node]++] = cpu;
+            if (node + 1 > placement.nodes) {
+                placement.nodes = node + 1;
+            }
+        }
+    }
+
+    // Deal one CPU of every node per round
+    placement.count = 0;
+    for (int round = 0; placement.count < MAX_CPUS; round++) {
+        int added = 0;
+        for (int node = 0; node < placement.nodes; node++) {
+            if (round < per_node[node]) {
+                placement.cpu[placement.count] = by_node[node][round];
+                placement.node[placement.count++] = node;
+                added = 1;
+            }
+        }
+        if (!added) {
+            break;
+        }
+    }
+}
+
+static inline int worker_cpu(int worker) {
+    return placement.cpu[worker % placement.count];
+}
+
+static inline int worker_node(int worker) {
+    return placement.node[worker % placement.count];
+}
+
+// Worker slot of the k-th CPU of node (wrapping around its CPUs), so the
+// threads of a process tied to node can be pinned with pin_worker()
+static inline int node_worker(int node, int k) {
+    int on_node = 0;
+    for (int w = 0; w < placement.count; w++) {
+        on_node += placement.node[w] == node;
+    }
+    if (on_node == 0) {
+        return k;
+    }
+    k %= on_node;
+    for (int w = 0; w < placement.count; w++) {
+        if (placement.node[w] == node && k-- == 0) {
+            return w;
+        }
+    }
+    return 0;
+}
+
+// Pins thread or process tid to the CPU of worker, returns 0 on success
+static inline int pin_worker(pid_t tid, int worker) {
+    unsigned long mask[MAX_CPUS / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    int cpu = worker_cpu(worker);
+    mask[cpu / (8 * sizeof(unsigned long))] = 1ul << (cpu % (8 * sizeof(unsigned long)));
+    return (int)syscall(SYS_sched_setaffinity, tid, sizeof(mask), mask);
+}
+
+// Binds the whole pages inside [start, start + bytes) to node, moving those
+// already faulted in; pages shared with a neighbouring slice are left alone
+static inline void place_pages(void *start, size_t bytes, int node) {
+    if (placement.nodes <= 1 || bytes == 0) {
+        return;
+    }
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t first = ((uintptr_t)start + page - 1) & ~(page - 1);
+    uintptr_t last = ((uintptr_t)start + bytes) & ~(page - 1);
+    if (first >= last) {
+        return;
+    }
+
+    unsigned long nodemask[MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+    nodemask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    static int warned = 0;
+    if (syscall(SYS_mbind, (void *)first, last - first, MPOL_PREFERRED, nodemask, MAX_NODES + 1,
+                MPOL_MF_MOVE) != 0 && !warned) {
+        perror("mbind");
+        warned = 1;
+    }
+}
+
+#endif
@@ -0,0 +1,515 @@
+#ifndef PARALLEL_API_H
+#define PARALLEL_API_H
+
+// Library entry points: sort or reduce a caller's array in parallel
+// The programs drive the kernels phase by phase so they can time, pin and
+// count every phase; code that only wants the answer calls these instead.
+// The caller owns a ParallelPool, started once and reused by every call:
+//   BACKEND_THREADS     a work-stealing thread pool
+//   BACKEND_PROCESSES   worker processes forked by parallel_pool_init(), plus
+//                       a MAP_SHARED staging buffer of a fixed capacity that
+//                       every call copies its array into (and a sort back out
+//                       of); arrays built in parallel_buffer() skip the copies
+// Each call keeps its job in a struct on its own stack: thread tasks get a
+// pointer to it, the process backend copies it into the pool's shared region,
+// which its workers find through proc_pool_context(). Nothing is kept in
+// globals between calls.
+//
+// DEFINE_PARALLEL_SORT(name, T, LESS) and DEFINE_PARALLEL_REDUCE(name, T, OP,
+// IDENTITY) generate entry points for any element type with the comparison or
+// operator inlined, so no call goes through a function pointer per element.
+// parallel_sort() and parallel_reduce() are the instances for elem_t.
+//
+//     ParallelPool pool;
+//     parallel_pool_init(&pool, BACKEND_THREADS, 8, 0);
+//     ParallelOptions opts = {&pool, PARALLEL_DESCENDING};
+//     parallel_sort(array, n, &opts);
+//     ChunkStats stats;
+//     parallel_reduce(array, n, &stats, &opts);
+//     parallel_pool_destroy(&pool);
+//
+// The process backend forks, so start it before the caller starts any other
+// thread: a child of a multithreaded process only gets the forking thread, and
+// locks other threads held (malloc's among them) stay locked in it. Calls on
+// one process pool run one at a time; thread pool calls may overlap. Neither
+// backend may be called from inside one of its own tasks.
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "elem_type.h"
+#include "max_kernels.h"
+#include "thread_pool.h"
+#include "process_pool.h"
+
+// Backends
+#define BACKEND_THREADS 0
+#define BACKEND_PROCESSES 1
+
+// Orders of parallel_sort()
+#define PARALLEL_ASCENDING 0
+#define PARALLEL_DESCENDING 1
+
+#define PARALLEL_JOB_SIZE 256       // Largest job struct a call hands the workers
+#define PARALLEL_SLOT_SIZE 64       // Result bytes per worker, process backend
+#define PARALLEL_INSERTION 16       // Sort ranges up to this size by insertion
+
+// Shared region of the process backend, mapped before the workers fork
+typedef struct {
+    chunk_fn fn;                    // Part function of the current call
+    _Alignas(64) unsigned char job[PARALLEL_JOB_SIZE];
+    _Alignas(64) unsigned char slots[]; // One result slot per worker
+} ParallelShared;
+
+typedef struct {
+    int backend;                    // BACKEND_THREADS or BACKEND_PROCESSES
+    int workers;
+    ThreadPool threads;             // BACKEND_THREADS
+    ProcessPool procs;              // BACKEND_PROCESSES
+    pthread_mutex_t lock;           // Held by the running process backend call
+    ParallelShared *shared;
+    size_t shared_size;
+    void *buffer;                   // Staging buffer
+    void *scratch;                  // As large again, for the merges of a sort
+    size_t capacity;                // Bytes of the staging buffer
+} ParallelPool;
+
+typedef struct {
+    ParallelPool *pool;
+    int order;                      // PARALLEL_ASCENDING or PARALLEL_DESCENDING
+} ParallelOptions;
+
+// Process backend task: runs part id of the job in the shared region
+static inline void parallel_proc_task(int id, int count) {
+    (void)count;
+    ParallelShared *shared = proc_pool_context();
+    shared->fn(id, shared->job);
+}
+
+// Starts workers threads or processes, at least 1
+// capacity is the largest array in bytes a process backend call accepts; the
+// thread backend ignores it. Do not copy or move the pool once started.
+static inline void parallel_pool_init(ParallelPool *pool, int backend, int workers, size_t capacity) {
+    pool->backend = backend;
+    pool->workers = (workers < 1) ? 1 : workers;
+    pool->shared = NULL;
+    pool->buffer = NULL;
+    pool->scratch = NULL;
+    pool->capacity = 0;
+    select_scan_kernel();           // Before the fork, so workers inherit it
+    if (backend != BACKEND_PROCESSES) {
+        pool_init(&pool->threads, pool->workers);
+        return;
+    }
+
+    // Slots, then the staging buffer and its scratch half on a page boundary
+    size_t header = sizeof(ParallelShared) + (size_t)pool->workers * PARALLEL_SLOT_SIZE;
+    header = (header + 4095) & ~(size_t)4095;
+    size_t staging = (capacity + 4095) & ~(size_t)4095;
+    pool->shared_size = header + 2 * staging;
+    pool->shared = mmap(NULL, pool->shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (pool->shared == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    pool->buffer = (char *)pool->shared + header;
+    pool->scratch = (char *)pool->buffer + staging;
+    pool->capacity = capacity;
+    pthread_mutex_init(&pool->lock, NULL);
+    proc_pool_init(&pool->procs, pool->workers);
+    proc_pool_set_context(&pool->procs, pool->shared);
+}
+
+// Stops the workers and releases the shared region
+static inline void parallel_pool_destroy(ParallelPool *pool) {
+    if (pool->backend != BACKEND_PROCESSES) {
+        pool_destroy(&pool->threads);
+        return;
+    }
+    proc_pool_destroy(&pool->procs);
+    pthread_mutex_destroy(&pool->lock);
+    munmap(pool->shared, pool->shared_size);
+}
+
+// Staging buffer of the process backend (capacity bytes), NULL for threads
+// An array placed here is not copied in or out by the calls
+static inline void *parallel_buffer(ParallelPool *pool) {
+    return pool->buffer;
+}
+
+// Parts a call on n elements is cut into, at most one per element
+static inline long parallel_parts(ParallelPool *pool, size_t n) {
+    return ((size_t)pool->workers > n) ? (long)n : pool->workers;
+}
+
+// First index of part i of n elements in parts parts; part parts starts at n
+static inline size_t parallel_part_start(size_t n, long parts, long i) {
+    return n / parts * i + n % parts * i / parts;
+}
+
+// Starts a call on bytes of array and returns where the workers see it: array
+// itself for threads, the staging buffer (holding the pool until
+// parallel_end()) for processes, or NULL if it does not fit there
+static inline void *parallel_begin(ParallelPool *pool, const void *array, size_t bytes) {
+    if (pool->backend != BACKEND_PROCESSES) {
+        return (void *)array;
+    }
+    if (bytes > pool->capacity) {
+        return NULL;
+    }
+    pthread_mutex_lock(&pool->lock);
+    if (array != pool->buffer) {
+        memcpy(pool->buffer, array, bytes);
+    }
+    return pool->buffer;
+}
+
+static inline void parallel_end(ParallelPool *pool) {
+    if (pool->backend == BACKEND_PROCESSES) {
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+// Runs fn(part, job) for every part in [0, parts) and waits for all of them
+// The process backend runs it on a copy of job, so job may only point into
+// the pool's shared region (staging buffer, scratch or result slots)
+static inline void parallel_run(ParallelPool *pool, long parts, chunk_fn fn, void *job, size_t job_size) {
+    if (pool->backend != BACKEND_PROCESSES) {
+        pool_for(&pool->threads, parts, fn, job);
+        return;
+    }
+    memcpy(pool->shared->job, job, job_size);
+    pool->shared->fn = fn;
+    proc_pool_run(&pool->procs, parallel_proc_task, (int)parts);
+}
+
+// ---- Typed Sort -------------------------------------------------------------
+// DEFINE_PARALLEL_SORT(name, T, LESS) defines
+//     int name(T *array, size_t n, const ParallelOptions *opts)
+// which sorts array so that LESS(array[i + 1], array[i]) holds for no i, and
+// returns 0, or -1 if array does not fit a process pool's staging buffer.
+// LESS(a, b) must be a strict weak order on T; pass the reversed comparison
+// for descending order. Every worker introsorts one part, then rounds of
+// pairwise merges join neighbouring runs until one is left. Each merge is cut
+// into pieces of equal output by a binary search for where an output rank
+// splits the two runs, so every round keeps all workers busy. Merges take the
+// left run first on ties.
+#define DEFINE_PARALLEL_SORT(name, T, LESS)                                                 \
+    static inline void name##_insertion(T *a, long n) {                                     \
+        for (long i = 1; i < n; i++) {                                                      \
+            T key = a[i];                                                                   \
+            long j = i - 1;                                                                 \
+            while (j >= 0 && LESS(key, a[j])) {                                             \
+                a[j + 1] = a[j];                                                            \
+                j--;                                                                        \
+            }                                                                               \
+            a[j + 1] = key;                                                                 \
+        }                                                                                   \
+    }                                                                                       \
+                                                                                            \
+    static inline void name##_sift(T *a, long root, long n) {                               \
+        T value = a[root];                                                                  \
+        long child;                                                                         \
+        while ((child = 2 * root + 1) < n) {                                                \
+            if (child + 1 < n && LESS(a[child], a[child + 1])) {                            \
+                child++;                                                                    \
+            }                                                                               \
+            if (!LESS(value, a[child])) {                                                   \
+                break;                                                                      \
+            }                                                                               \
+            a[root] = a[child];                                                             \
+            root = child;                                                                   \
+        }                                                                                   \
+        a[root] = value;                                                                    \
+    }                                                                                       \
+                                                                                            \
+    static inline void name##_heapsort(T *a, long n) {                                      \
+        for (long i = n / 2 - 1; i >= 0; i--) {                                             \
+            name##_sift(a, i, n);                                                           \
+        }                                                                                   \
+        for (long end = n - 1; end > 0; end--) {                                            \
+            T top = a[0];                                                                   \
+            a[0] = a[end];                                                                  \
+            a[end] = top;                                                                   \
+            name##_sift(a, 0, end);                                                         \
+        }                                                                                   \
+    }                                                                                       \
+                                                                                            \
+    /* Median of three Hoare partitions down to insertion sort size; heapsort */            \
+    /* once depth is spent, so adversarial inputs stay O(n log n) */                        \
+    static inline void name##_introsort(T *a, long n, int depth) {                          \
+        while (n > PARALLEL_INSERTION) {                                                    \
+            if (depth-- == 0) {                                                             \
+                name##_heapsort(a, n);                                                      \
+                return;                                                                     \
+            }                                                                               \
+            long mid = n / 2;                                                               \
+            T t;                                                                            \
+            if (LESS(a[mid], a[0])) { t = a[mid]; a[mid] = a[0]; a[0] = t; }                \
+            if (LESS(a[n - 1], a[mid])) { t = a[n - 1]; a[n - 1] = a[mid]; a[mid] = t; }    \
+            if (LESS(a[mid], a[0])) { t = a[mid]; a[mid] = a[0]; a[0] = t; }                \
+            T pivot = a[mid];                                                               \
+            long i = -1;                                                                    \
+            long j = n;                                                                     \
+            while (1) {                                                                     \
+                do { i++; } while (LESS(a[i], pivot));                                      \
+                do { j--; } while (LESS(pivot, a[j]));                                      \
+                if (i >= j) {                                                               \
+                    break;                                                                  \
+                }                                                                           \
+                t = a[i];                                                                   \
+                a[i] = a[j];                                                                \
+                a[j] = t;                                                                   \
+            }                                                                               \
+            /* Recurse into the smaller side, loop on the larger */                         \
+            if (j + 1 < n - j - 1) {                                                        \
+                name##_introsort(a, j + 1, depth);                                          \
+                a += j + 1;                                                                 \
+                n -= j + 1;                                                                 \
+            } else {                                                                        \
+                name##_introsort(a + j + 1, n - j - 1, depth);                              \
+                n = j + 1;                                                                  \
+            }                                                                               \
+        }                                                                                   \
+        name##_insertion(a, n);                                                             \
+    }                                                                                       \
+                                                                                            \
+    /* Elements of a in the first k of the merge of a and b */                              \
+    static inline long name##_co_rank(const T *a, long na, const T *b, long nb, long k) {   \
+        long lo = (k > nb) ? k - nb : 0;                                                    \
+        long hi = (k < na) ? k : na;                                                        \
+        while (lo < hi) {                                                                   \
+            long i = lo + (hi - lo) / 2;                                                    \
+            long j = k - i;                                                                 \
+            if (j > 0 && !LESS(b[j - 1], a[i])) {                                           \
+                lo = i + 1;                                                                 \
+            } else {                                                                        \
+                hi = i;                                                                     \
+            }                                                                               \
+        }                                                                                   \
+        return lo;                                                                          \
+    }                                                                                       \
+                                                                                            \
+    static inline void name##_merge(const T *a, long na, const T *b, long nb, T *out) {     \
+        long i = 0;                                                                         \
+        long j = 0;                                                                         \
+        while (i < na && j < nb) {                                                          \
+            *out++ = LESS(b[j], a[i]) ? b[j++] : a[i++];                                    \
+        }                                                                                   \
+        memcpy(out, a + i, (na - i) * sizeof(T));                                           \
+        memcpy(out + (na - i), b + j, (nb - j) * sizeof(T));                                \
+    }                                                                                       \
+                                                                                            \
+    typedef struct {                                                                        \
+        T *data;                                                                            \
+        T *scratch;                                                                         \
+        T *src;                     /* Runs of the current merge round */                   \
+        T *dst;                                                                             \
+        size_t n;                                                                           \
+        long parts;                                                                         \
+        long width;                 /* Parts per run in the current round */                \
+        long pieces;                /* Pieces per merge in the current round */             \
+        int copy;                   /* Sorted parts start the merges from scratch */        \
+    } name##_job;                                                                           \
+                                                                                            \
+    static inline void name##_sort_part(long part, void *arg) {                             \
+        name##_job *job = arg;                                                              \
+        size_t start = parallel_part_start(job->n, job->parts, part);                       \
+        long len = (long)(parallel_part_start(job->n, job->parts, part + 1) - start);       \
+        int depth = 0;                                                                      \
+        for (long m = len; m > 1; m >>= 1) {                                                \
+            depth += 2;                                                                     \
+        }                                                                                   \
+        name##_introsort(job->data + start, len, depth);                                    \
+        if (job->copy) {                                                                    \
+            memcpy(job->scratch + start, job->data + start, len * sizeof(T));               \
+        }                                                                                   \
+    }                                                                                       \
+                                                                                            \
+    /* Merges piece task % pieces of run pair task / pieces */                              \
+    static inline void name##_merge_part(long task, void *arg) {                            \
+        name##_job *job = arg;                                                              \
+        long pair = task / job->pieces;                                                     \
+        long piece = task % job->pieces;                                                    \
+        long first = pair * 2 * job->width;                                                 \
+        long middle = (first + job->width < job->parts) ? first + job->width : job->parts;  \
+        long last = (middle + job->width < job->parts) ? middle + job->width : job->parts;  \
+        size_t lo = parallel_part_start(job->n, job->parts, first);                         \
+        size_t mid = parallel_part_start(job->n, job->parts, middle);                       \
+        size_t len = parallel_part_start(job->n, job->parts, last) - lo;                    \
+        const T *a = job->src + lo;                                                         \
+        const T *b = job->src + mid;                                                        \
+        long na = (long)(mid - lo);                                                         \
+        long nb = (long)len - na;                                                           \
+        long out = (long)parallel_part_start(len, job->pieces, piece);                      \
+        long out_end = (long)parallel_part_start(len, job->pieces, piece + 1);              \
+        long ia = name##_co_rank(a, na, b, nb, out);                                        \
+        long ia_end = name##_co_rank(a, na, b, nb, out_end);                                \
+        name##_merge(a + ia, ia_end - ia, b + (out - ia), (out_end - ia_end) - (out - ia),  \
+                     job->dst + lo + out);                                                  \
+    }                                                                                       \
+                                                                                            \
+    static inline int name(T *array, size_t n, const ParallelOptions *opts) {               \
+        _Static_assert(sizeof(name##_job) <= PARALLEL_JOB_SIZE, #name ": job too large");   \
+        ParallelPool *pool = opts->pool;                                                    \
+        if (n < 2) {                                                                        \
+            return 0;                                                                       \
+        }                                                                                   \
+        name##_job job;                                                                     \
+        job.data = parallel_begin(pool, array, n * sizeof(T));                              \
+        if (job.data == NULL) {                                                             \
+            return -1;                                                                      \
+        }                                                                                   \
+        job.n = n;                                                                          \
+        job.parts = parallel_parts(pool, n);                                                \
+        job.scratch = NULL;                                                                 \
+        int rounds = 0;                                                                     \
+        for (long width = 1; width < job.parts; width *= 2) {                               \
+            rounds++;                                                                       \
+        }                                                                                   \
+        if (rounds > 0) {                                                                   \
+            job.scratch = (pool->backend == BACKEND_PROCESSES) ? pool->scratch              \
+                                                               : malloc(n * sizeof(T));     \
+        }                                                                                   \
+        /* Odd round counts start from scratch, so the last round ends in data */           \
+        job.copy = rounds % 2;                                                              \
+        parallel_run(pool, job.parts, name##_sort_part, &job, sizeof(job));                 \
+                                                                                            \
+        job.src = job.copy ? job.scratch : job.data;                                        \
+        job.dst = job.copy ? job.data : job.scratch;                                        \
+        for (job.width = 1; job.width < job.parts; job.width *= 2) {                        \
+            long runs = (job.parts + job.width - 1) / job.width;                            \
+            long pairs = (runs + 1) / 2;                                                    \
+            job.pieces = (job.parts + pairs - 1) / pairs;                                   \
+            parallel_run(pool, pairs * job.pieces, name##_merge_part, &job, sizeof(job));   \
+            T *swap = job.src;                                                              \
+            job.src = job.dst;                                                              \
+            job.dst = swap;                                                                 \
+        }                                                                                   \
+                                                                                            \
+        if (pool->backend == BACKEND_PROCESSES) {                                           \
+            if (array != job.data) {                                                        \
+                memcpy(array, job.data, n * sizeof(T));                                     \
+            }                                                                               \
+        } else {                                                                            \
+            free(job.scratch);                                                              \
+        }                                                                                   \
+        parallel_end(pool);                                                                 \
+        return 0;                                                                           \
+    }
+
+// ---- Typed Reduce -----------------------------------------------------------
+// DEFINE_PARALLEL_REDUCE(name, T, OP, IDENTITY) defines
+//     int name(const T *array, size_t n, T *result, const ParallelOptions *opts)
+// which folds array into *result with acc = OP(acc, x) starting from IDENTITY
+// and returns 0, or -1 if array does not fit a process pool's staging buffer.
+// OP must be associative with IDENTITY as its identity; parts are combined in
+// order, so it need not be commutative. T fits in PARALLEL_SLOT_SIZE bytes.
+#define DEFINE_PARALLEL_REDUCE(name, T, OP, IDENTITY)                                       \
+    typedef struct {                                                                        \
+        const T *data;                                                                      \
+        size_t n;                                                                           \
+        long parts;                                                                         \
+        T *results;                 /* One per part */                                      \
+    } name##_job;                                                                           \
+                                                                                            \
+    static inline void name##_part(long part, void *arg) {                                  \
+        name##_job *job = arg;                                                              \
+        size_t end = parallel_part_start(job->n, job->parts, part + 1);                     \
+        T acc = IDENTITY;                                                                   \
+        for (size_t i = parallel_part_start(job->n, job->parts, part); i < end; i++) {      \
+            acc = OP(acc, job->data[i]);                                                    \
+        }                                                                                   \
+        job->results[part] = acc;                                                           \
+    }                                                                                       \
+                                                                                            \
+    static inline int name(const T *array, size_t n, T *result, const ParallelOptions *opts) { \
+        _Static_assert(sizeof(T) <= PARALLEL_SLOT_SIZE, #name ": element type too large");  \
+        ParallelPool *pool = opts->pool;                                                    \
+        T acc = IDENTITY;                                                                   \
+        if (n == 0) {                                                                       \
+            *result = acc;                                                                  \
+            return 0;                                                                       \
+        }                                                                                   \
+        name##_job job;                                                                     \
+        job.data = parallel_begin(pool, array, n * sizeof(T));                              \
+        if (job.data == NULL) {                                                             \
+            return -1;                                                                      \
+        }                                                                                   \
+        job.n = n;                                                                          \
+        job.parts = parallel_parts(pool, n);                                                \
+        T local[job.parts];                                                                 \
+        job.results = (pool->backend == BACKEND_PROCESSES) ? (T *)pool->shared->slots : local; \
+        parallel_run(pool, job.parts, name##_part, &job, sizeof(job));                      \
+        for (long i = 0; i < job.parts; i++) {                                              \
+            acc = OP(acc, job.results[i]);                                                  \
+        }                                                                                   \
+        parallel_end(pool);                                                                 \
+        *result = acc;                                                                      \
+        return 0;                                                                           \
+    }
+
+// ---- elem_t Entry Points ----------------------------------------------------
+
+#define PARALLEL_ELEM_LESS(a, b) ((a) < (b))
+#define PARALLEL_ELEM_GREATER(a, b) ((b) < (a))
+
+DEFINE_PARALLEL_SORT(parallel_sort_ascending, elem_t, PARALLEL_ELEM_LESS)
+DEFINE_PARALLEL_SORT(parallel_sort_descending, elem_t, PARALLEL_ELEM_GREATER)
+
+// Sorts array[0..n) in opts->order; 0 on success, -1 if it does not fit a
+// process pool's staging buffer
+static inline int parallel_sort(elem_t *array, size_t n, const ParallelOptions *opts) {
+    if (opts->order == PARALLEL_DESCENDING) {
+        return parallel_sort_descending(array, n, opts);
+    }
+    return parallel_sort_ascending(array, n, opts);
+}
+
+typedef struct {
+    const elem_t *data;
+    size_t n;
+    long parts;
+    ChunkStats *results;            // One per part
+} ParallelScanJob;
+
+static inline void parallel_scan_part(long part, void *arg) {
+    ParallelScanJob *job = arg;
+    size_t start = parallel_part_start(job->n, job->parts, part);
+    ChunkStats local = scan_range(&job->data[start], parallel_part_start(job->n, job->parts, part + 1) - start);
+    local.argmax += start;
+    job->results[part] = local;
+}
+
+// Max, min, sum and index of the first max of array[0..n) into *result with
+// the scan kernels; 0 on success, -1 if it does not fit a process pool's
+// staging buffer. Parts are combined in order, so the result matches a serial
+// scan (up to rounding of floating point sums).
+static inline int parallel_reduce(const elem_t *array, size_t n, ChunkStats *result, const ParallelOptions *opts) {
+    _Static_assert(sizeof(ChunkStats) <= PARALLEL_SLOT_SIZE, "ChunkStats too large for a result slot");
+    ParallelPool *pool = opts->pool;
+    *result = empty_stats();
+    if (n == 0) {
+        return 0;
+    }
+    ParallelScanJob job;
+    job.data = parallel_begin(pool, array, n * sizeof(elem_t));
+    if (job.data == NULL) {
+        return -1;
+    }
+    job.n = n;
+    job.parts = parallel_parts(pool, n);
+    ChunkStats local[job.parts];
+    job.results = (pool->backend == BACKEND_PROCESSES) ? (ChunkStats *)pool->shared->slots : local;
+    parallel_run(pool, job.parts, parallel_scan_part, &job, sizeof(job));
+    for (long i = 0; i < job.parts; i++) {
+        combine_stats(result, &job.results[i]);
+    }
+    parallel_end(pool);
+    return 0;
+}
+
+#endif
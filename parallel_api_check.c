@@ -0,0 +1,252 @@
+// Checks the parallel_api.h entry points against serial references
+// Every -w worker count runs on both backends (processes first, before this
+// program has started any thread) over every input distribution:
+//   parallel_sort() ascending and descending against qsort()
+//   parallel_reduce() against a plain loop for max, min, sum and argmax
+//   a DEFINE_PARALLEL_SORT record type, checked for order and that every
+//   record kept its key
+//   DEFINE_PARALLEL_REDUCE with a wrapping uint64 sum and with composition of
+//   affine maps, which is not commutative and so catches out of order combines
+//   the process backend's zero-copy path (array in parallel_buffer()) and its
+//   refusal of an array larger than the staging buffer
+// Prints one line per backend and worker count; exits 1 if any check failed.
+//
+//     ./bench.sh -t double check -n 1e6 -w 1,3,8
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "parallel_api.h"
+#include "bench_options.h"
+#include "data_gen.h"
+
+// Record with a key to sort by and its original index
+typedef struct {
+    uint32_t key;
+    uint32_t id;
+} Record;
+
+#define RECORD_LESS(a, b) ((a).key < (b).key)
+DEFINE_PARALLEL_SORT(sort_records, Record, RECORD_LESS)
+
+#define ADD_U64(a, b) ((a) + (b))
+DEFINE_PARALLEL_REDUCE(sum_u64, uint64_t, ADD_U64, 0)
+
+// x -> mul * x + add modulo 2^64
+typedef struct {
+    uint64_t mul;
+    uint64_t add;
+} Affine;
+
+// f, then g
+#define AFFINE_THEN(f, g) ((Affine){(f).mul * (g).mul, (f).add * (g).mul + (g).add})
+DEFINE_PARALLEL_REDUCE(compose_affine, Affine, AFFINE_THEN, ((Affine){1, 0}))
+
+// Global Variables
+size_t ARRAY_SIZE;                  // Set by -n
+elem_t *input;                      // Current distribution
+elem_t *sorted;                     // input sorted by qsort()
+elem_t *work;                       // Array handed to the calls under test
+Record *records;
+Record *record_work;
+uint64_t *words;                    // Element keys, input of the uint64 reduces
+Affine *maps;
+int failures;                       // Failed checks of the current config
+int checks;                         // Checks of the current config
+
+static int compare_elems(const void *a, const void *b) {
+    elem_t x = *(const elem_t *)a;
+    elem_t y = *(const elem_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Counts a check and reports it if it failed
+void check(int ok, const char *backend, int workers, const char *dist, const char *what) {
+    checks++;
+    if (!ok) {
+        failures++;
+        fprintf(stderr, "FAIL %s x%d %s: %s\n", backend, workers, dist, what);
+    }
+}
+
+// Compares work[0..n) to sorted, read backwards when descending
+int matches_sorted(const elem_t *array, int descending) {
+    for (size_t i = 0; i < ARRAY_SIZE; i++) {
+        if (!(array[i] == sorted[descending ? ARRAY_SIZE - 1 - i : i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Serial max, min, sum and first argmax, compared with stats
+int matches_scan(const ChunkStats *stats) {
+    elem_t max = input[0];
+    elem_t min = input[0];
+    size_t argmax = 0;
+#if ELEM_IS_INTEGER
+    unsigned long long sum = 0;     // Wraps like the kernels' sums
+#else
+    double sum = 0;
+    double magnitude = 0;
+#endif
+    for (size_t i = 0; i < ARRAY_SIZE; i++) {
+        if (input[i] > max) {
+            max = input[i];
+            argmax = i;
+        }
+        if (input[i] < min) {
+            min = input[i];
+        }
+#if ELEM_IS_INTEGER
+        sum += (unsigned long long)input[i];
+#else
+        sum += input[i];
+        magnitude += fabs((double)input[i]);
+#endif
+    }
+    if (stats->max != max || stats->min != min || stats->argmax != argmax) {
+        return 0;
+    }
+#if ELEM_IS_INTEGER
+    return (unsigned long long)stats->sum == sum;
+#else
+    // Parts add in another order, so only rounding may differ; sums of the
+    // full double range overflow in any order and are not compared
+    return !isfinite(magnitude) || fabs((double)stats->sum - sum) <= 1e-9 * magnitude;
+#endif
+}
+
+// Records sorted by key, each still holding the key it started with
+int records_sorted(const Record *array) {
+    char *seen = calloc(ARRAY_SIZE, 1);
+    int ok = 1;
+    for (size_t i = 0; i < ARRAY_SIZE && ok; i++) {
+        uint32_t id = array[i].id;
+        ok = id < ARRAY_SIZE && !seen[id] && array[i].key == records[id].key &&
+             (i == 0 || array[i - 1].key <= array[i].key);
+        if (ok) {
+            seen[id] = 1;
+        }
+    }
+    free(seen);
+    return ok;
+}
+
+// Runs every check on one pool
+void run_checks(ParallelPool *pool, const char *backend, int workers, const char *dist) {
+    ParallelOptions opts = {pool, PARALLEL_ASCENDING};
+    size_t bytes = ARRAY_SIZE * sizeof(elem_t);
+
+    // ---- elem_t Sort and Reduce ---------------------------------------------
+    memcpy(work, input, bytes);
+    check(parallel_sort(work, ARRAY_SIZE, &opts) == 0 && matches_sorted(work, 0), backend, workers, dist,
+          "parallel_sort ascending");
+    opts.order = PARALLEL_DESCENDING;
+    memcpy(work, input, bytes);
+    check(parallel_sort(work, ARRAY_SIZE, &opts) == 0 && matches_sorted(work, 1), backend, workers, dist,
+          "parallel_sort descending");
+    opts.order = PARALLEL_ASCENDING;
+
+    ChunkStats stats;
+    check(parallel_reduce(input, ARRAY_SIZE, &stats, &opts) == 0 && matches_scan(&stats), backend, workers, dist,
+          "parallel_reduce");
+
+    // ---- Typed Entry Points -------------------------------------------------
+    memcpy(record_work, records, ARRAY_SIZE * sizeof(Record));
+    check(sort_records(record_work, ARRAY_SIZE, &opts) == 0 && records_sorted(record_work), backend, workers, dist,
+          "DEFINE_PARALLEL_SORT records");
+
+    uint64_t sum = 0;
+    uint64_t expected_sum = 0;
+    Affine map = {1, 0};
+    Affine expected_map = {1, 0};
+    for (size_t i = 0; i < ARRAY_SIZE; i++) {
+        expected_sum += words[i];
+        expected_map = AFFINE_THEN(expected_map, maps[i]);
+    }
+    check(sum_u64(words, ARRAY_SIZE, &sum, &opts) == 0 && sum == expected_sum, backend, workers, dist,
+          "DEFINE_PARALLEL_REDUCE uint64 sum");
+    check(compose_affine(maps, ARRAY_SIZE, &map, &opts) == 0 && map.mul == expected_map.mul &&
+          map.add == expected_map.add, backend, workers, dist, "DEFINE_PARALLEL_REDUCE affine composition");
+
+    // ---- Process Backend Staging --------------------------------------------
+    elem_t *staged = parallel_buffer(pool);
+    if (staged != NULL) {
+        memcpy(staged, input, bytes);
+        check(parallel_sort(staged, ARRAY_SIZE, &opts) == 0 && matches_sorted(staged, 0), backend, workers, dist,
+              "parallel_sort in the staging buffer");
+        check(compose_affine(maps, ARRAY_SIZE + 1, &map, &opts) == -1, backend, workers, dist,
+              "array larger than the staging buffer refused");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    if (parse_options(argc, argv, &opts, "") != 0) {
+        return 1;
+    }
+    if (opts.mode != NULL) {
+        fprintf(stderr, "Unknown mode '%s' (this program takes none)\n", opts.mode);
+        return 1;
+    }
+    ARRAY_SIZE = opts.n;
+    if (ARRAY_SIZE > UINT32_MAX) {
+        fprintf(stderr, "-n must fit the 32-bit record ids\n");
+        return 1;
+    }
+
+    input = malloc(ARRAY_SIZE * sizeof(elem_t));
+    sorted = malloc(ARRAY_SIZE * sizeof(elem_t));
+    work = malloc(ARRAY_SIZE * sizeof(elem_t));
+    records = malloc(ARRAY_SIZE * sizeof(Record));
+    record_work = malloc(ARRAY_SIZE * sizeof(Record));
+    words = malloc(ARRAY_SIZE * sizeof(uint64_t));
+    maps = malloc((ARRAY_SIZE + 1) * sizeof(Affine));   // One past the staging buffer
+    size_t capacity = ARRAY_SIZE * sizeof(Affine);   // Largest array of the checks
+    int failed = 0;
+
+    // Processes first, while this program has no other thread to fork beside
+    const int backends[] = {BACKEND_PROCESSES, BACKEND_THREADS};
+    const char *backend_names[] = {"processes", "threads"};
+    for (int b = 0; b < 2; b++) {
+        for (int c = 0; c < opts.num_configs; c++) {
+            ParallelPool pool;
+            parallel_pool_init(&pool, backends[b], opts.workers[c], capacity);
+            checks = 0;
+            failures = 0;
+
+            for (int d = 0; d < DISTRIBUTIONS; d++) {
+                generate_range(input, 0, ARRAY_SIZE, ARRAY_SIZE, d, opts.seed);
+                memcpy(sorted, input, ARRAY_SIZE * sizeof(elem_t));
+                qsort(sorted, ARRAY_SIZE, sizeof(elem_t), compare_elems);
+                for (size_t i = 0; i < ARRAY_SIZE; i++) {
+                    uint64_t bits = counter_random(opts.seed + d, i);
+                    records[i].key = (uint32_t)(bits % 1000);  // Many equal keys
+                    records[i].id = (uint32_t)i;
+                    words[i] = elem_to_key(input[i]);
+                    maps[i].mul = bits | 1;
+                    maps[i].add = bits >> 7;
+                }
+                maps[ARRAY_SIZE] = maps[0];
+                run_checks(&pool, backend_names[b], opts.workers[c], distribution_names[d]);
+            }
+
+            parallel_pool_destroy(&pool);
+            printf("%-9s x%-3d %zu x %s: %d/%d checks passed\n", backend_names[b], opts.workers[c], ARRAY_SIZE,
+                   ELEM_NAME, checks - failures, checks);
+            failed |= (failures > 0);
+        }
+    }
+
+    free(maps);
+    free(words);
+    free(record_work);
+    free(records);
+    free(work);
+    free(sorted);
+    free(input);
+    return failed;
+}
@@ -4,160 +4,634 @@
 #include <pthread.h>
 #include <time.h>
 #include <sys/resource.h>
-
-// Array Size
-#define ARRAY_SIZE 131072
+#include "thread_pool.h"
+#include "sort_kernels.h"
+#include "elem_type.h"
+#include "bench_options.h"
+#include "bench_report.h"
+#include "loser_tree.h"
+#include "external_sort.h"
+#include "arena.h"
+
+// Sort Modes
+#define SORT_MERGE 0                    // quickSort chunks, then one multiway merge
+#define SORT_RADIX 1                    // Counting / LSD radix sort, no merge phase
+#define SORT_EXTERNAL 2                 // File sort: merge mode sorts runs, loser tree merges them
+#define SORT_SAMPLE 3                   // Splitters scatter keys into buckets sorted in place, no merge phase
+#define RADIX_BITS 8                    // Digit width of each radix pass
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define COUNTING_SORT_MAX_RANGE 65536   // Key ranges up to this use counting sort
 
 // Global Variables
-int array[ARRAY_SIZE];
-int chunk_size;
+elem_t *array;
+elem_t *buffer;                     // Scratch space swapped with array each pass
+long ARRAY_SIZE;                    // Set by -n
 int NUM_THREADS;
+ThreadPool pool;                    // Workers reused by every config and phase
+elem_t *pass_src;                   // Input of current merge / radix pass
+elem_t *pass_dst;                   // Output of current merge / radix pass
+int affinity;                       // Slice t always runs on pinned worker t (-a)
+SliceTiming *timings;               // Chunk sort time of each thread (affinity mode)
+int input_dist;                     // DIST_* of the generated array (-d)
+uint64_t input_seed;                // Generator seed (-s)
+long input_elems;                   // Elements of the whole input
+long fill_offset;                   // Input index of array[0] while filling
+elem_t *source;                     // Mapped -i file copied into array before each run, NULL to generate
+PhaseStats *run_phase;              // Collects the runs' sort phases (external mode)
+Arena arena;                        // Holds array, buffer, histograms and worker scratch (-H)
+Arena *worker_arenas;               // Scratch slice of each worker, the main thread's last
+
+// Radix Mode Variables
+int sort_mode;                      // SORT_* of the run
+int verbose;                        // Per-thread progress lines (-v)
+PerfSet perf;                       // Counters of main thread and workers (-p)
+uint64_t *thread_min;               // Smallest key seen by each thread
+uint64_t *thread_max;               // Largest key seen by each thread
+long *histograms;                   // One row of key/digit/bucket counts per thread
+long key_offsets[COUNTING_SORT_MAX_RANGE + 1];
+uint64_t key_min;                   // Smallest key in array (elem_to_key order)
+int key_range;                      // Number of distinct key values (counting sort)
+int radix_shift;                    // Bit offset of current radix digit
+
+// Sample Mode Variables
+SampleSplitters splitters;          // Drawn from array at the start of each sort
+long bucket_starts[2 * SAMPLE_MAX_RANGES + 1];
+int bucket_ids[2 * SAMPLE_MAX_RANGES];
+
+// Returns first index of a thread's equal slice; slice ends at next thread's start
+// Chunks of the map phase are the same slices, so any N splits evenly
+// Quotient and remainder are scaled apart, so nothing overflows a long
+long slice_start(int thread_id) {
+    return (long)(ARRAY_SIZE / NUM_THREADS * thread_id + ARRAY_SIZE % NUM_THREADS * thread_id / NUM_THREADS);
+}
 
-// Returns current memory usage by program
-long get_memory_usage() {
-    FILE* fp = fopen("/proc/self/status", "r");
-    if (fp == NULL) {
-        perror("Error opening /proc/self/status");
-        return 0;
+// Runs fn once per thread slice; in affinity mode slice t runs on worker t,
+// whose node holds its pages
+void run_slices(task_fn fn, int *thread_ids) {
+    if (affinity) {
+        pool_run_pinned(&pool, fn, thread_ids, NUM_THREADS);
+    } else {
+        pool_run(&pool, fn, thread_ids, NUM_THREADS);
+    }
+}
+
+// Fills thread id's slice of array; every element depends only on its index,
+// so the array is the same for any thread count
+void* fill_slice(void* arg) {
+    int thread_id = *(int *)arg;
+    long start = slice_start(thread_id);
+    long end = slice_start(thread_id + 1);
+    if (source != NULL) {
+        memcpy(&array[start], &source[start], (end - start) * sizeof(elem_t));
+        return NULL;
+    }
+    for (long i = start; i < end; i++) {
+        array[i] = generate_element(input_dist, input_seed, fill_offset + i, input_elems);
+    }
+    return NULL;
+}
+
+// Binds scratch slice id to the worker running this task
+void* bind_worker_scratch(void* arg) {
+    bind_scratch(&worker_arenas[*(int *)arg]);
+    return NULL;
+}
+
+// Faults in thread id's slices of array and buffer and its worker's scratch
+// slice before the timed runs (-P); in affinity mode on the worker, and so
+// the node, that will use them
+void* prefault_slice(void* arg) {
+    int thread_id = *(int *)arg;
+    long start = slice_start(thread_id);
+    long length = slice_start(thread_id + 1) - start;
+    if (array != NULL && arena_owns(&arena, array)) {
+        prefault(&array[start], length * sizeof(elem_t));
+    }
+    prefault(&buffer[start], length * sizeof(elem_t));
+    prefault(worker_arenas[thread_id].base, worker_arenas[thread_id].size);
+    return NULL;
+}
+
+// Thread routine for assigning local chunks and sorting them
+void* chunk_sorting(void* arg) {
+    int thread_id = *(int *)arg;
+    struct timespec t_start, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    long start = slice_start(thread_id);
+    long end = slice_start(thread_id + 1) - 1;
+
+    if (verbose) {
+        printf("\tThread %d: Sorting %ld to %ld\n", thread_id, start, end);
+        fflush(stdout);
+    }
+
+    // Sort chunk in place, letting idle workers steal its partitions
+    // Chunks are disjoint, so no thread needs a private copy
+    long local_size = end - start + 1;
+    parallelQuickSort(&pool, &array[start], local_size);
+
+    if (affinity) {
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+        timings[thread_id].seconds = (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+        timings[thread_id].bytes = local_size * sizeof(elem_t);
     }
-    char line[256];
-    long vm_rss = -1;
+    return NULL;
+}
+
+// Task for the single merge pass
+// Thread t writes an equal slice of the output: multiway_split() finds where
+// the slice's first and last ranks cut every sorted chunk, and a loser tree
+// merges those pieces of all chunks straight into pass_dst
+void* merge_slice(void* arg) {
+    int thread_id = *(int *)arg;
+    long bounds[NUM_THREADS + 1];
+    for (int c = 0; c <= NUM_THREADS; c++) {
+        bounds[c] = slice_start(c);
+    }
+    long from[NUM_THREADS];
+    long to[NUM_THREADS];
+    multiway_split(pass_src, bounds, NUM_THREADS, slice_start(thread_id), from);
+    multiway_split(pass_src, bounds, NUM_THREADS, slice_start(thread_id + 1), to);
+    multiway_merge(pass_src, bounds, NUM_THREADS, from, to, &pass_dst[slice_start(thread_id)]);
+    return NULL;
+}
 
-    // Scan file until VmRSS field is found
-    while (fgets(line, sizeof(line), fp) != NULL) {
-        if (strncmp(line, "VmRSS:", 6) == 0) {
-            sscanf(line + 6, "%ld", &vm_rss);
-            break;
+// Task copying a thread's slice of pass_src back into array
+void* copy_back_slice(void* arg) {
+    int thread_id = *(int *)arg;
+    long start = slice_start(thread_id);
+    memcpy(&array[start], &pass_src[start], (slice_start(thread_id + 1) - start) * sizeof(elem_t));
+    return NULL;
+}
+
+// Task finding the key range of a thread's slice
+void* find_key_range(void* arg) {
+    int thread_id = *(int *)arg;
+    long start = slice_start(thread_id);
+    long end = slice_start(thread_id + 1);
+
+    if (verbose) {
+        printf("\tThread %d: Counting keys %ld to %ld\n", thread_id, start, end - 1);
+        fflush(stdout);
+    }
+
+    // Empty slices (more threads than elements) leave an empty range
+    uint64_t local_min = UINT64_MAX;
+    uint64_t local_max = 0;
+    for (long i = start; i < end; i++) {
+        uint64_t key = elem_to_key(array[i]);
+        if (key < local_min) {
+            local_min = key;
         }
+        if (key > local_max) {
+            local_max = key;
+        }
+    }
+    thread_min[thread_id] = local_min;
+    thread_max[thread_id] = local_max;
+    return NULL;
+}
+
+// Counting sort task: histogram of a thread's slice
+void* count_keys(void* arg) {
+    int thread_id = *(int *)arg;
+    long *histogram = &histograms[(long)thread_id * COUNTING_SORT_MAX_RANGE];
+    memset(histogram, 0, key_range * sizeof(long));
+    for (long i = slice_start(thread_id); i < slice_start(thread_id + 1); i++) {
+        histogram[elem_to_key(array[i]) - key_min]++;
     }
+    return NULL;
+}
 
-    fclose(fp);
-    return vm_rss;
+// Counting sort task: merges per-thread histograms for a slice of the keys
+void* sum_key_counts(void* arg) {
+    int thread_id = *(int *)arg;
+    int key_start = (int)((long)key_range * thread_id / NUM_THREADS);
+    int key_end = (int)((long)key_range * (thread_id + 1) / NUM_THREADS);
+    for (int k = key_start; k < key_end; k++) {
+        long count = 0;
+        for (int t = 0; t < NUM_THREADS; t++) {
+            count += histograms[(long)t * COUNTING_SORT_MAX_RANGE + k];
+        }
+        key_offsets[k] = count;
+    }
+    return NULL;
 }
 
-// Recursieve QuickSort Implementation
-void quickSort(int *array, int low, int high) {
-    if (low < high) {
-        int pivot = array[low];
-        int i = low;
-        int j = high;
-
-        // Partitioning
-        while (i < j) {
-            // Find first element larger than pivot
-            while (array[i] <= pivot && i <= high - 1) {
-                i++;
-            }
-            // Find first element smaller than pivot
-            while (array[j] > pivot && j >= low + 1) {
-                j--;
-            }
-            if (i < j) {
-                // Swap elements
-                int temp = array[i];
-                array[i] = array[j];
-                array[j] = temp;
-            }
+// Counting sort task: writes a thread's slice of the output from key_offsets
+void* fill_keys(void* arg) {
+    int thread_id = *(int *)arg;
+    long start = slice_start(thread_id);
+    long end = slice_start(thread_id + 1);
+
+    // Find first key whose run overlaps this slice
+    int low = 0;
+    int high = key_range - 1;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (key_offsets[mid + 1] <= start) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    int k = low;
+    for (long i = start; i < end; i++) {
+        while (key_offsets[k + 1] <= i) {
+            k++;
         }
+        array[i] = key_to_elem(key_min + k);
+    }
+    return NULL;
+}
 
-        // Place pivot in correct position
-        int temp = array[low];
-        array[low] = array[j];
-        array[j] = temp;
+// Radix digit of an element's key relative to key_min
+int radix_digit(elem_t x) {
+    return (int)(((elem_to_key(x) - key_min) >> radix_shift) & (RADIX_BUCKETS - 1));
+}
 
-        // Recursive calls
-        quickSort(array, low, j - 1);
-        quickSort(array, j + 1, high);
+// Radix sort task: digit histogram of a thread's slice of pass_src
+void* count_digits(void* arg) {
+    int thread_id = *(int *)arg;
+    long *histogram = &histograms[thread_id * RADIX_BUCKETS];
+    memset(histogram, 0, RADIX_BUCKETS * sizeof(long));
+    for (long i = slice_start(thread_id); i < slice_start(thread_id + 1); i++) {
+        histogram[radix_digit(pass_src[i])]++;
     }
+    return NULL;
 }
 
-// Thread routine for assigning local chunks and sorting them
-void* chunk_sorting(void* arg) {
+// Radix sort task: scatters a thread's slice of pass_src into pass_dst
+// Digit d of thread t starts after all smaller digits and after digit d of
+// lower-numbered threads, which keeps the pass stable
+void* scatter_digits(void* arg) {
     int thread_id = *(int *)arg;
-    int start = thread_id * chunk_size;
-    int end = 0;
+    long offsets[RADIX_BUCKETS];
+    long base = 0;
+    for (int d = 0; d < RADIX_BUCKETS; d++) {
+        offsets[d] = base;
+        for (int t = 0; t < NUM_THREADS; t++) {
+            long count = histograms[t * RADIX_BUCKETS + d];
+            if (t < thread_id) {
+                offsets[d] += count;
+            }
+            base += count;
+        }
+    }
 
-    // Last thread gets last elements
-    if (thread_id == NUM_THREADS - 1) {
-        end = ARRAY_SIZE - 1;
-    } else {
-        end = start + chunk_size - 1;
+    for (long i = slice_start(thread_id); i < slice_start(thread_id + 1); i++) {
+        pass_dst[offsets[radix_digit(pass_src[i])]++] = pass_src[i];
     }
+    return NULL;
+}
 
-    printf("\tThread %d: Sorting %d to %d\n", thread_id, start, end);
-    fflush(stdout);
+// Swaps pass_src and pass_dst after a pass
+void swap_pass_buffers() {
+    elem_t *temp = pass_src;
+    pass_src = pass_dst;
+    pass_dst = temp;
+}
 
-    // Copy local chunk into temporary array
-    int local_size = end - start + 1;
-    int *local_array = malloc(local_size * sizeof(int));
-    memcpy(local_array, &array[start], local_size * sizeof(int));
+// Radix mode: finds the key range, then counting sorts small ranges and LSD
+// radix sorts (key - key_min) on the rest, skipping digits above the range.
+// Keys come from elem_to_key(), so signed and floating point types sort too.
+// Output is globally sorted, so there is no merge phase.
+void radix_sort(int *thread_ids) {
+    run_slices(find_key_range, thread_ids);
+    uint64_t min = thread_min[0];
+    uint64_t max = thread_max[0];
+    for (int t = 1; t < NUM_THREADS; t++) {
+        if (thread_min[t] < min) {
+            min = thread_min[t];
+        }
+        if (thread_max[t] > max) {
+            max = thread_max[t];
+        }
+    }
+    key_min = min;
+    uint64_t span = max - min;
+
+    if (span < COUNTING_SORT_MAX_RANGE) {
+        key_range = (int)span + 1;
+        run_slices(count_keys, thread_ids);
+        run_slices(sum_key_counts, thread_ids);
+
+        // Exclusive prefix sum turns counts into starting positions
+        long total = 0;
+        for (int k = 0; k < key_range; k++) {
+            long count = key_offsets[k];
+            key_offsets[k] = total;
+            total += count;
+        }
+        key_offsets[key_range] = total;
+
+        run_slices(fill_keys, thread_ids);
+        return;
+    }
+
+    pass_src = array;
+    pass_dst = buffer;
+    for (radix_shift = 0; radix_shift < ELEM_BITS && (span >> radix_shift) != 0; radix_shift += RADIX_BITS) {
+        run_slices(count_digits, thread_ids);
+        run_slices(scatter_digits, thread_ids);
+        swap_pass_buffers();
+    }
+
+    // Odd number of passes leaves the sorted result in buffer
+    if (pass_src != array) {
+        run_slices(copy_back_slice, thread_ids);
+    }
+}
 
-    // Sort local chunk
-    quickSort(local_array, 0, local_size - 1);
+// Sample sort task: bucket sizes of a thread's slice
+void* count_buckets(void* arg) {
+    int thread_id = *(int *)arg;
+    long start = slice_start(thread_id);
+    long end = slice_start(thread_id + 1);
 
-    // Copy sorted chunk back into main array
-    memcpy(&array[start], local_array, local_size * sizeof(int));
+    if (verbose) {
+        printf("\tThread %d: Classifying %ld to %ld\n", thread_id, start, end - 1);
+        fflush(stdout);
+    }
 
-    free(local_array);
-    pthread_exit(NULL);
+    int buckets = sample_buckets(&splitters);
+    long *histogram = &histograms[(long)thread_id * buckets];
+    memset(histogram, 0, buckets * sizeof(long));
+    sample_count(&splitters, &array[start], end - start, histogram);
+    return NULL;
 }
 
-// Merge two sorted subarrays into single sorted array
-void merge(int *array, int low, int mid, int high) {
-    int n1 = mid - low + 1;
-    int n2 = high - mid;
+// Sample sort task: scatters a thread's slice of array into the buckets in buffer
+void* scatter_buckets(void* arg) {
+    int thread_id = *(int *)arg;
+    int buckets = sample_buckets(&splitters);
+    long offsets[buckets];
+    sample_offsets(histograms, NUM_THREADS, buckets, thread_id, offsets);
+    long start = slice_start(thread_id);
+    sample_scatter(&splitters, &array[start], slice_start(thread_id + 1) - start, offsets, buffer);
+    return NULL;
+}
 
-    // Create temp arrays
-    int *left = malloc(n1 * sizeof(int));
-    int *right = malloc(n2 * sizeof(int));
+// Sample sort task: copies one bucket back into its final place in array and
+// sorts it there, letting idle workers steal its partitions
+void* sort_bucket(void* arg) {
+    int bucket = *(int *)arg;
+    long start = bucket_starts[bucket];
+    long length = bucket_starts[bucket + 1] - start;
+    memcpy(&array[start], &buffer[start], length * sizeof(elem_t));
+    if (!sample_bucket_sorted(bucket)) {
+        parallelQuickSort(&pool, &array[start], length);
+    }
+    return NULL;
+}
 
-    // Copy data to temp arrays
-    for (int i = 0; i < n1; i++) {
-        left[i] = array[low + i];
+// Sample mode: splitters from a random oversample cut the keys into ranges,
+// threads classify their slices and scatter them into buffer through a
+// per-thread prefix sum, and the buckets are sorted on the pool. Every bucket
+// already sits at its final position, so there is no merge phase.
+void sample_sort(int *thread_ids) {
+    sample_splitters(&splitters, array, ARRAY_SIZE, NUM_THREADS);
+    int buckets = sample_buckets(&splitters);
+    run_slices(count_buckets, thread_ids);
+    run_slices(scatter_buckets, thread_ids);
+
+    sample_offsets(histograms, NUM_THREADS, buckets, 0, bucket_starts);
+    bucket_starts[buckets] = ARRAY_SIZE;
+    for (int b = 0; b < buckets; b++) {
+        bucket_ids[b] = b;
     }
-    for (int j = 0; j < n2; j++) {
-        right[j] = array[mid + 1 + j];
+    pool_run(&pool, sort_bucket, bucket_ids, buckets);
+}
+
+// Sorts array with NUM_THREADS pool workers in the selected sort mode
+// Counters and heap bytes of each phase are added to map / reduce unless NULL;
+// radix and sample modes have no merge, so all of it counts as map phase
+void parallel_sort(int *thread_ids, PhaseStats *map, PhaseStats *reduce) {
+    phase_mark(&perf, NUM_THREADS + 1, NULL);
+
+    if (sort_mode == SORT_RADIX) {
+        // ---- Radix Sort -----------------------------------------------------
+        // Threads share per-thread histograms and scatter the whole array
+        radix_sort(thread_ids);
+        phase_mark(&perf, NUM_THREADS + 1, map);
+        return;
     }
 
-    // Merge until one array runs out
-    int i = 0;
-    int j = 0;
-    int k = low;
-    while (i < n1 && j < n2) {
-        if (left[i] <= right[j]) {
-            array[k++] = left[i++];
-        } else {
-            array[k++] = right[j++];
-        }
+    if (sort_mode == SORT_SAMPLE) {
+        // ---- Sample Sort ----------------------------------------------------
+        // Threads share per-thread bucket counts and scatter the whole array
+        sample_sort(thread_ids);
+        phase_mark(&perf, NUM_THREADS + 1, map);
+        return;
     }
 
-    // Copy remaining elements
-    while (i < n1) {
-        array[k++] = left[i++];
+    // ---- Map Phase ----------------------------------------------------------
+    // Each pool task sorts one chunk of array
+    run_slices(chunk_sorting, thread_ids);
+    phase_mark(&perf, NUM_THREADS + 1, map);
+
+    // ---- Reduce Phase -------------------------------------------------------
+    // Threads merge all sorted chunks at once into buffer, each element
+    // moving once, then copy the result back into array
+    if (NUM_THREADS > 1) {
+        pass_src = array;
+        pass_dst = buffer;
+        run_slices(merge_slice, thread_ids);
+        swap_pass_buffers();
+        run_slices(copy_back_slice, thread_ids);
     }
-    while (j < n2) {
-        array[k++] = right[j++];
+    phase_mark(&perf, NUM_THREADS + 1, reduce);
+}
+
+// External mode: sorts one run in memory the way merge mode sorts array
+void sort_run(elem_t *run, size_t n, void *arg) {
+    array = run;
+    ARRAY_SIZE = n;
+    parallel_sort((int *)arg, run_phase, run_phase);
+}
+
+// External mode without -i: writes the generated input to a new file in
+// pieces of at most piece elements, each filled on the pool
+void generate_file(const char *path, long piece, int *thread_ids) {
+    int fd = open_or_die(path, O_WRONLY | O_CREAT | O_TRUNC);
+    array = map_elements(piece, sizeof(elem_t), 0);
+    for (fill_offset = 0; fill_offset < input_elems; fill_offset += piece) {
+        ARRAY_SIZE = (input_elems - fill_offset < piece) ? input_elems - fill_offset : piece;
+        run_slices(fill_slice, thread_ids);
+        write_fully(fd, array, ARRAY_SIZE * sizeof(elem_t));
     }
+    munmap(array, piece * sizeof(elem_t));
+    array = NULL;
+    fill_offset = 0;
+    close(fd);
+}
 
-    free(left);
-    free(right);
+// Prints the first 20 elements of array, or of the file at path in external mode
+void print_sample(const char *path) {
+    elem_t sample[20];
+    long count = (ARRAY_SIZE < 20) ? ARRAY_SIZE : 20;
+    if (sort_mode == SORT_EXTERNAL) {
+        count = (long)read_elements(path, sample, 20);
+    } else {
+        memcpy(sample, array, count * sizeof(elem_t));
+    }
+    for (long i = 0; i < count; i++) {
+        printf(ELEM_FMT " ", ELEM_PRINT(sample[i]));
+    }
 }
 
 // Main Method
-int main(void) {
-    printf("------------------------------------------------------------------------------------------------------------------------\n");
+int main(int argc, char *argv[]) {
+    // Array size, thread counts and mode: merge (default), "radix" selects the counting / radix
+    // sort path, "sample" the sample sort, "external" sorts a file (-i) through runs on disk
+    Options opts;
+    if (parse_options(argc, argv, &opts, "[merge|radix|sample|external]") != 0) {
+        return 1;
+    }
+    const char *mode_name = opts.mode ? opts.mode : "merge";
+    if (strcmp(mode_name, "merge") == 0) {
+        sort_mode = SORT_MERGE;
+    } else if (strcmp(mode_name, "radix") == 0) {
+        sort_mode = SORT_RADIX;
+    } else if (strcmp(mode_name, "external") == 0) {
+        sort_mode = SORT_EXTERNAL;
+    } else if (strcmp(mode_name, "sample") == 0) {
+        sort_mode = SORT_SAMPLE;
+    } else {
+        fprintf(stderr, "Unknown sort mode '%s' (expected merge, radix, sample or external)\n", mode_name);
+        return 1;
+    }
+    verbose = opts.verbose;
+    affinity = opts.affinity;
+    input_dist = opts.dist;
+    input_seed = opts.seed;
+    FILE *report = open_report(&opts);
+
+    // A -i file is sorted in place with -W, otherwise copied into array before
+    // every run like the generated input; external mode streams it instead
+    size_t file_elems = opts.n;
+    if (opts.input != NULL && sort_mode != SORT_EXTERNAL) {
+        if (opts.write_back) {
+            array = map_file(opts.input, sizeof(elem_t), &file_elems, 1);
+        } else {
+            source = map_file(opts.input, sizeof(elem_t), &file_elems, 0);
+        }
+        opts.n = file_elems;
+    }
+    ARRAY_SIZE = opts.n;
+    input_elems = opts.n;
 
-    int thread_count[] = {1, 2, 4, 8};  // Thread counts
-    double performance[4];              // For storing execution times
-    long memory_usage[4];               // For storing memory usage
+    int *thread_count = opts.workers;   // Thread counts
+    BenchResult results[MAX_CONFIGS];   // Timing statistics of each config
+    double *samples = malloc(opts.reps * sizeof(double));
 
     struct timespec c_start, c_end;
-    long mem_before, mem_after;
+
+    // Start workers once, sized for the largest thread count
+    pool_init(&pool, opts.max_workers);
+
+    // Pin worker i to its CPU, spreading workers over the NUMA nodes
+    if (affinity) {
+        placement_init();
+        for (int i = 0; i < opts.max_workers; i++) {
+            pin_worker(pool_worker_tid(&pool, i), i);
+        }
+        timings = aligned_alloc(64, opts.max_workers * sizeof(SliceTiming));
+        printf(" - Affinity: %d workers over %d CPUs on %d NUMA nodes\n",
+               opts.max_workers, placement.count, placement.nodes);
+    }
+
+    // External mode sorts the -i file, or a generated one, into -o or a temp file
+    ExtSort ext = {0};
+    char input_path[4096];
+    char output_path[4096];
+    const char *tmpdir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    if (sort_mode == SORT_EXTERNAL) {
+        snprintf(input_path, sizeof(input_path), "%s", opts.input ? opts.input : "");
+        snprintf(output_path, sizeof(output_path), "%s", opts.output ? opts.output : "");
+        if (opts.input == NULL) {
+            snprintf(input_path, sizeof(input_path), "%s/extsort-input.%d", tmpdir, (int)getpid());
+            NUM_THREADS = opts.max_workers;
+            int thread_ids[NUM_THREADS];
+            for (int i = 0; i < NUM_THREADS; i++) {
+                thread_ids[i] = i;
+            }
+            generate_file(input_path, (opts.run_elems < opts.n) ? opts.run_elems : opts.n, thread_ids);
+        }
+        if (opts.output == NULL) {
+            snprintf(output_path, sizeof(output_path), "%s/extsort-output.%d", tmpdir, (int)getpid());
+        }
+        if (ext_sort_open(&ext, input_path, output_path, tmpdir, opts.run_elems, opts.direct) != 0) {
+            if (opts.input == NULL) {
+                unlink(input_path);
+            }
+            if (opts.output == NULL) {
+                unlink(output_path);
+            }
+            return 1;
+        }
+        ARRAY_SIZE = ext.n;
+        opts.n = ext.n;
+    }
+
+    // One arena holds array (unless sorted in place), buffer (one run in
+    // external mode) and the external run buffers, the radix / sample
+    // histograms sized for the most threads, and a scratch slice per worker
+    // plus one for the main thread
+    size_t buffer_elems = (sort_mode == SORT_EXTERNAL) ? ext.run_elems : (size_t)ARRAY_SIZE;
+    size_t array_elems = (sort_mode == SORT_EXTERNAL || array != NULL) ? 0 : (size_t)ARRAY_SIZE;
+    size_t run_bytes = (sort_mode == SORT_EXTERNAL) ? ext_sort_memory_bytes(&ext) : 0;
+    size_t histogram_entries = (sort_mode == SORT_RADIX) ? (size_t)opts.max_workers * COUNTING_SORT_MAX_RANGE :
+                               (sort_mode == SORT_SAMPLE) ? (size_t)opts.max_workers * 2 * SAMPLE_MAX_RANGES : 0;
+    arena_reserve(&arena, (array_elems + buffer_elems) * sizeof(elem_t) + run_bytes + histogram_entries * sizeof(long) +
+                  2 * opts.max_workers * sizeof(uint64_t) + (opts.max_workers + 1) * WORKER_ARENA_BYTES +
+                  4 * HUGE_PAGE_SIZE, 0, opts.pages);
+    if (array_elems > 0) {
+        array = arena_take(&arena, array_elems * sizeof(elem_t));
+    }
+    if (run_bytes > 0) {
+        ext.memory = arena_take(&arena, run_bytes);
+    }
+    buffer = arena_take(&arena, buffer_elems * sizeof(elem_t));
+    histograms = arena_take(&arena, histogram_entries * sizeof(long));
+    thread_min = arena_take(&arena, opts.max_workers * sizeof(uint64_t));
+    thread_max = arena_take(&arena, opts.max_workers * sizeof(uint64_t));
+    worker_arenas = malloc((opts.max_workers + 1) * sizeof(Arena));
+    arena_split(&arena, worker_arenas, opts.max_workers + 1, WORKER_ARENA_BYTES);
+    int worker_ids[opts.max_workers];
+    for (int i = 0; i < opts.max_workers; i++) {
+        worker_ids[i] = i;
+    }
+    pool_run_pinned(&pool, bind_worker_scratch, worker_ids, opts.max_workers);
+    bind_scratch(&worker_arenas[opts.max_workers]);
+
+    printf("------------------------------------------------------------------------------------------------------------------------\n");
+    printf(" - Array: %ld x %s\n", ARRAY_SIZE, ELEM_NAME);
+    if (sort_mode == SORT_EXTERNAL) {
+        printf(" - Input: %s\n", opts.input ? input_path : distribution_names[input_dist]);
+        printf(" - External: %d runs of %zu elements, %s I/O\n", ext.runs, ext.run_elems,
+               opts.direct ? "direct" : "buffered");
+    } else if (opts.input != NULL) {
+        printf(" - Input: %s%s\n", opts.input, opts.write_back ? ", sorted in place" : "");
+    } else {
+        printf(" - Input: %s, seed %llu\n", distribution_names[input_dist], (unsigned long long)input_seed);
+    }
+    printf(" - Arena: %zu MB, %s pages%s\n", arena.size >> 20, page_mode_names[arena.pages],
+           opts.prefault ? ", prefaulted" : "");
+
+    // Counters for main thread (slot 0) and every worker
+    if (opts.perf) {
+        pid_t tids[opts.max_workers + 1];
+        tids[0] = 0;
+        for (int i = 0; i < opts.max_workers; i++) {
+            tids[i + 1] = pool_worker_tid(&pool, i);
+        }
+        perf_set_open(&perf, tids, opts.max_workers + 1);
+    }
 
     // Loop through the different thread counts
-    for (int t = 0; t <4; t++) {
+    for (int t = 0; t < opts.num_configs; t++) {
         NUM_THREADS = thread_count[t];
-        chunk_size = ARRAY_SIZE / NUM_THREADS;
 
         // Label thread configurations
         if (NUM_THREADS == 1){
@@ -166,91 +640,126 @@ int main(void) {
             printf(" - %d THREADS:\n", NUM_THREADS);
         }
 
-        // Generate & Fill Array
-        srand(42);
-        for (int i = 0; i < ARRAY_SIZE; i++) {
-            array[i] = rand() % 100;
-        }
-
-        // Print sample of unsorted array
-        printf("    - Before sorting (first 20 elements):\n\t");
-        for (int i = 0; i < 20; i++) {
-            printf("%d ", array[i]);
-        }
-        printf("\n\n");
-
-        // Record memory and time before sorting
-        mem_before = get_memory_usage();
-        clock_gettime(CLOCK_MONOTONIC, &c_start);
-
-        // ---- Map Phase ------------------------------------------------------
-        // Each thread sorts one chunk of array
-        pthread_t threads[NUM_THREADS];
         int thread_ids[NUM_THREADS];
-
-        printf("    - Sorting:\n");
         for (int i = 0; i < NUM_THREADS; i++) {
             thread_ids[i] = i;
-            pthread_create(&threads[i], NULL, chunk_sorting, &thread_ids[i]);
+        }
+        pool_set_active(&pool, NUM_THREADS);
+
+        // Bind each thread's slice of array and buffer to its node
+        if (affinity && sort_mode != SORT_EXTERNAL && !opts.write_back) {
+            for (int i = 0; i < NUM_THREADS; i++) {
+                long length = slice_start(i + 1) - slice_start(i);
+                place_pages(&array[slice_start(i)], length * sizeof(elem_t), worker_node(i));
+                place_pages(&buffer[slice_start(i)], length * sizeof(elem_t), worker_node(i));
+            }
         }
 
-        // Wait for all threads to complete
-        for (int i = 0; i < NUM_THREADS; i++) {
-            pthread_join(threads[i], NULL);
+        // Fault the pages in before the timed runs instead of on first touch
+        if (opts.prefault && sort_mode != SORT_EXTERNAL) {
+            long long faults = page_faults();
+            clock_gettime(CLOCK_MONOTONIC, &c_start);
+            run_slices(prefault_slice, thread_ids);
+            clock_gettime(CLOCK_MONOTONIC, &c_end);
+            printf("    - Prefault: %f sec, %lld page faults\n",
+                   (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9, page_faults() - faults);
         }
-        printf("\n\t - All threads finished -\n");
 
+        // Warmup runs first, then timed runs, each on a freshly filled array
+        begin_result(&results[t], NUM_THREADS, 0);
+        for (int rep = -opts.warmups; rep < opts.reps; rep++) {
+            // Generate & Fill Array in parallel; the external input and a file
+            // sorted in place are read where they lie
+            if (sort_mode != SORT_EXTERNAL && !opts.write_back) {
+                run_slices(fill_slice, thread_ids);
+            }
+
+            // Print sample of unsorted array once per config
+            if (rep == -opts.warmups) {
+                printf("    - Before sorting (first 20 elements):\n\t");
+                print_sample(input_path);
+                printf("\n\n");
+                printf((sort_mode == SORT_RADIX) ? "    - Radix Sorting:\n" :
+                       (sort_mode == SORT_EXTERNAL) ? "    - External Sorting:\n" :
+                       (sort_mode == SORT_SAMPLE) ? "    - Sample Sorting:\n" : "    - Sorting:\n");
+                fflush(stdout);
+            }
+
+            // Start memory window and time before sorting
+            reset_peak_rss();
+            clock_gettime(CLOCK_MONOTONIC, &c_start);
+
+            if (sort_mode == SORT_EXTERNAL) {
+                // Run formation is the map phase, the merge of the runs the reduce phase
+                run_phase = (rep >= 0) ? &results[t].map : NULL;
+                ext_sort_runs(&ext, sort_run, thread_ids);
+                phase_mark(&perf, NUM_THREADS + 1, run_phase);
+                ext_sort_merge(&ext);
+                phase_mark(&perf, NUM_THREADS + 1, (rep >= 0) ? &results[t].reduce : NULL);
+            } else if (rep >= 0) {
+                parallel_sort(thread_ids, &results[t].map, &results[t].reduce);
+            } else {
+                parallel_sort(thread_ids, NULL, NULL);
+            }
 
-        // ---- Reduce Phase ---------------------------------------------------
-        // Merge sorted chunks iteratively into single sorted array
-        int step = chunk_size;
-        while (step < ARRAY_SIZE) {
-            for (int i = 0; i < ARRAY_SIZE; i += 2 * step) {
-                int low = i;
-                int mid = i + step - 1;
-                int high = 0;
-                if ((i + 2 * step - 1) < ARRAY_SIZE) {
-                    high = i + 2 * step - 1;
-                } else {
-                    high = ARRAY_SIZE - 1;
+            // Record time and memory after sorting
+            clock_gettime(CLOCK_MONOTONIC, &c_end);
+
+            if (rep >= 0) {
+                record_run(&results[t], read_peak_rss_kb(), NULL);
+                if (affinity && sort_mode == SORT_MERGE) {
+                    record_slices(&results[t], timings, NUM_THREADS);
                 }
-                merge(array, low, mid, high);
+                samples[rep] = (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9;
             }
-            step *= 2; // Merge larger sections each pass
         }
-
-        // Record memory and time after sorting
-        mem_after = get_memory_usage();
-        clock_gettime(CLOCK_MONOTONIC, &c_end);
+        printf("\n\t - All threads finished -\n");
 
         // Print sample after sorting
         printf("\n    - After sorting (first 20 elements):\n\t");
-        for (int i = 0; i < 20; i++) {
-            printf("%d ", array[i]);
-        }
+        print_sample(output_path);
         printf("\n\n");
 
-        // Calculate Execution time
-        double execution_time = (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9;
-        printf("    - Execution Time: %f sec", execution_time);
-        performance[t] = execution_time;
+        // Calculate Execution time statistics
+        summarize_samples(samples, opts.reps, opts.n, &results[t]);
+        printf("    - Execution Time: %f sec (median of %d, p95 %f, stddev %f)",
+               results[t].median, opts.reps, results[t].p95, results[t].stddev);
 
-        // Calculate memory usage
-        long mem_usage = mem_after - mem_before;
-        printf("\n\n    - Memory Before: %ld KB", mem_before);
-        printf("\n    - Memory After: %ld KB", mem_after);
-        printf("\n\n    - Memory Delta: %ld KB", mem_usage);
-        memory_usage[t] = mem_usage;
+        // Memory high water mark and heap bytes allocated per run
+        printf("\n\n    - Peak RSS: %ld KB", results[t].peak_rss_kb);
+        printf("\n    - Heap Allocated: %lld B map, %lld B reduce",
+               results[t].map.alloc_bytes, results[t].reduce.alloc_bytes);
+        printf("\n    - Page Faults: %lld map, %lld reduce", results[t].map.faults, results[t].reduce.faults);
 
         printf("\n------------------------------------------------------------------------------------------------------------------------\n");
     }
 
     // Display performance summary for all thread configs
-    printf("\nPerformance Summary:\n");
-    printf("Threads\t   Time (s)\tMem Delta (KB)\n");
-    for (int t = 0; t < 4; t++) {
-        printf("%d\t   %.6f\t%ld\n", thread_count[t], performance[t], memory_usage[t]);
+    fflush(stdout);
+    const char *mode_names[] = {"merge", "radix", "external", "sample"};
+    print_report(report, &opts, "parallel_sort_multithreading", mode_names[sort_mode], "Threads", results);
+
+    perf_set_close(&perf);
+    pool_destroy(&pool);
+    free(timings);
+    free(samples);
+    arena_release(&arena);
+    free(worker_arenas);
+    if (sort_mode == SORT_EXTERNAL) {
+        ext_sort_close(&ext);
+        if (opts.input == NULL) {
+            unlink(input_path);
+        }
+        if (opts.output == NULL) {
+            unlink(output_path);
+        }
+        return 0;
+    }
+    if (opts.write_back) {
+        munmap(array, ARRAY_SIZE * sizeof(elem_t));
+    }
+    if (source != NULL) {
+        munmap(source, ARRAY_SIZE * sizeof(elem_t));
     }
-
     return 0;
 }
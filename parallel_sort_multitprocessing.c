@@ -2,132 +2,352 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
-#include <sys/wait.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <time.h>
-
-// Array Size
-#define ARRAY_SIZE 131072
+#include "elem_type.h"
+#include "bench_options.h"
+#include "bench_report.h"
+#include "process_pool.h"
+#include "sort_kernels.h"
+#include "loser_tree.h"
+#include "arena.h"
+
+// Sort Modes
+#define SORT_MERGE 0                    // quickSort chunks, then one multiway merge
+#define SORT_SAMPLE 1                   // Splitters scatter keys into buckets sorted in place, no merge phase
 
 // Global Variables
-int *array;
-int chunk_size;
+elem_t *array;
+long ARRAY_SIZE;                    // Set by -n
+long chunk_size;
 int NUM_PROCESSES;
-long *shared_mem_usage;
-
-// Returns current memory usage by program
-long get_memory_usage() {
-    FILE* fp = fopen("/proc/self/status", "r");
-    if (fp == NULL) {
-        perror("Error opening /proc/self/status");
-        return 0;
-    }
-    char line[256];
-    long vm_rss = -1;
-
-    // Scan file until VmRSS field is found
-    while (fgets(line, sizeof(line), fp) != NULL) {
-        if (strncmp(line, "VmRSS:", 6) == 0) {
-            sscanf(line + 6, "%ld", &vm_rss);
-            break;
-        }
+elem_t *buffer;                     // Shared merge output, copied back into array
+ProcessPool pool;                   // Worker processes reused by every config
+int verbose;                        // Per-process progress lines (-v)
+int smaps_enabled;                  // Read child PSS / USS (-m)
+ChildReport *child_reports;         // One shared heap and memory slot per task
+PerfSet perf;                       // Counters of parent (slot 0) and workers (-p)
+int affinity;                       // Chunk i always runs on pinned worker i (-a)
+int input_dist;                     // DIST_* of the generated array (-d)
+uint64_t input_seed;                // Generator seed (-s)
+elem_t *source;                     // Mapped -i file copied into array before each run, NULL to generate
+SliceTiming *timings;               // Shared sort time of each chunk (affinity mode)
+int sort_mode;                      // SORT_* of the run
+Arena arena;                        // Shared: array, buffer, sample tables and worker scratch (-H)
+Arena *worker_arenas;               // Scratch slice of each worker, the parent's last
+
+// Sample Mode Variables, all shared with the workers
+SampleSplitters *splitters;         // Drawn from array by the parent at the start of each sort
+long *histograms;                   // One row of bucket counts per chunk
+long *bucket_starts;                // First index of each bucket, then ARRAY_SIZE
+
+// First index of chunk c; the last chunk also takes the remainder
+long chunk_start(int c) {
+    return (c < NUM_PROCESSES) ? c * chunk_size : ARRAY_SIZE;
+}
+
+// Fills chunk id of count with the generated input, or with its part of the
+// -i file, run by a pool worker process
+// Every element depends only on its index, so the array is the same for any count
+void fill_chunk(int id, int count) {
+    NUM_PROCESSES = count;
+    chunk_size = ARRAY_SIZE / count;
+    if (source != NULL) {
+        memcpy(&array[chunk_start(id)], &source[chunk_start(id)], (chunk_start(id + 1) - chunk_start(id)) * sizeof(elem_t));
+    } else {
+        generate_range(array, chunk_start(id), chunk_start(id + 1), ARRAY_SIZE, input_dist, input_seed);
     }
+}
 
-    fclose(fp);
-    return vm_rss;
+// Binds scratch slice id to worker id, which keeps it for its lifetime
+void bind_worker_scratch(int id, int count) {
+    (void)count;
+    bind_scratch(&worker_arenas[id]);
 }
 
-// Recursieve QuickSort Implementation
-void quickSort(int *array, int low, int high) {
-    if (low < high) {
-        int pivot = array[low];
-        int i = low;
-        int j = high;
-
-        // Partitioning
-        while (i < j) {
-            // Find first element larger than pivot
-            while (array[i] <= pivot && i <= high - 1) {
-                i++;
-            }
-            // Find first element smaller than pivot
-            while (array[j] > pivot && j >= low + 1) {
-                j--;
-            }
-            if (i < j) {
-                // Swap elements
-                int temp = array[i];
-                array[i] = array[j];
-                array[j] = temp;
-            }
-        }
+// Faults in chunk id of count of array and buffer and the worker's scratch
+// slice before the timed runs (-P); the pages are shared, so the parent and
+// the other workers find them present
+void prefault_chunk(int id, int count) {
+    NUM_PROCESSES = count;
+    chunk_size = ARRAY_SIZE / count;
+    long length = chunk_start(id + 1) - chunk_start(id);
+    if (arena_owns(&arena, array)) {
+        prefault(&array[chunk_start(id)], length * sizeof(elem_t));
+    }
+    prefault(&buffer[chunk_start(id)], length * sizeof(elem_t));
+    prefault(worker_arenas[id].base, worker_arenas[id].size);
+}
+
+// Sorts chunk id of count, run by a pool worker process
+void chunk_sorting(int id, int count) {
+    // Worker measures itself from here until its chunk is sorted
+    long long heap_mark = child_report_begin();
+    struct timespec t_start, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
 
-        // Place pivot in correct position
-        int temp = array[low];
-        array[low] = array[j];
-        array[j] = temp;
+    // Adopt the parent's config in this worker's copy of the globals
+    NUM_PROCESSES = count;
+    chunk_size = ARRAY_SIZE / count;
 
-        // Recursive calls
-        quickSort(array, low, j - 1);
-        quickSort(array, j + 1, high);
+    long start = chunk_start(id);
+    long end = chunk_start(id + 1) - 1;
+
+    if (verbose) {
+        printf("\tProcess %d (PID=%d): sorting %ld to %ld\n", id, getpid(), start, end);
+        fflush(stdout);
     }
-}
 
-// Merge two sorted subarrays into single sorted array
-void merge(int *array, int low, int mid, int high) {
-    int n1 = mid - low + 1;
-    int n2 = high - mid;
+    // Sort chunk in place in the shared mapping; chunks are disjoint,
+    // so the parent sees the result without a copy
+    quickSort(array, start, end);
 
-    // Create temp arrays
-    int *left = malloc(n1 * sizeof(int));
-    int *right = malloc(n2 * sizeof(int));
+    if (affinity) {
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+        timings[id].seconds = (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+        timings[id].bytes = (end - start + 1) * sizeof(elem_t);
+    }
+
+    child_report_end(&child_reports[id], heap_mark, smaps_enabled);
+}
 
-    // Copy data to temp arrays
-    for (int i = 0; i < n1; i++) {
-        left[i] = array[low + i];
+// Merges output chunk id of count from all sorted chunks, run by a pool worker
+// multiway_split() finds where the chunk's first and last ranks cut every
+// sorted chunk of array, and a loser tree merges those pieces into buffer
+void merge_chunk(int id, int count) {
+    NUM_PROCESSES = count;
+    chunk_size = ARRAY_SIZE / count;
+    long bounds[count + 1];
+    for (int c = 0; c <= count; c++) {
+        bounds[c] = chunk_start(c);
     }
-    for (int j = 0; j < n2; j++) {
-        right[j] = array[mid + 1 + j];
+    long from[count];
+    long to[count];
+    multiway_split(array, bounds, count, chunk_start(id), from);
+    multiway_split(array, bounds, count, chunk_start(id + 1), to);
+    multiway_merge(array, bounds, count, from, to, &buffer[chunk_start(id)]);
+}
+
+// Copies output chunk id of count from buffer back into array
+void copy_back_chunk(int id, int count) {
+    NUM_PROCESSES = count;
+    chunk_size = ARRAY_SIZE / count;
+    memcpy(&array[chunk_start(id)], &buffer[chunk_start(id)], (chunk_start(id + 1) - chunk_start(id)) * sizeof(elem_t));
+}
+
+// Runs fn for every chunk on the pool; in affinity mode chunk i runs on worker i
+void run_chunks(proc_task_fn fn) {
+    if (affinity) {
+        proc_pool_run_pinned(&pool, fn, NUM_PROCESSES);
+    } else {
+        proc_pool_run(&pool, fn, NUM_PROCESSES);
     }
+}
 
-    // Merge until one array runs out
-    int i = 0;
-    int j = 0;
-    int k = low;
-    while (i < n1 && j < n2) {
-        if (left[i] <= right[j]) {
-            array[k++] = left[i++];
-        } else {
-            array[k++] = right[j++];
-        }
+// Sample sort task: bucket sizes of chunk id of count
+void count_chunk_buckets(int id, int count) {
+    NUM_PROCESSES = count;
+    chunk_size = ARRAY_SIZE / count;
+    long start = chunk_start(id);
+    long end = chunk_start(id + 1);
+
+    if (verbose) {
+        printf("\tProcess %d (PID=%d): classifying %ld to %ld\n", id, getpid(), start, end - 1);
+        fflush(stdout);
     }
 
-    // Copy remaining elements
-    while (i < n1) {
-        array[k++] = left[i++];
+    int buckets = sample_buckets(splitters);
+    long *histogram = &histograms[(long)id * buckets];
+    memset(histogram, 0, buckets * sizeof(long));
+    sample_count(splitters, &array[start], end - start, histogram);
+}
+
+// Sample sort task: scatters chunk id of count into the buckets in buffer
+// The worker reports its memory here, after touching its share of buffer
+void scatter_chunk_buckets(int id, int count) {
+    long long heap_mark = child_report_begin();
+    NUM_PROCESSES = count;
+    chunk_size = ARRAY_SIZE / count;
+    int buckets = sample_buckets(splitters);
+    long offsets[buckets];
+    sample_offsets(histograms, count, buckets, id, offsets);
+    long start = chunk_start(id);
+    sample_scatter(splitters, &array[start], chunk_start(id + 1) - start, offsets, buffer);
+    child_report_end(&child_reports[id], heap_mark, smaps_enabled);
+}
+
+// Sample sort task: copies bucket id back into its final place in array and
+// sorts it there; count is the number of buckets
+void sort_bucket(int id, int count) {
+    (void)count;
+    long start = bucket_starts[id];
+    long end = bucket_starts[id + 1];
+    memcpy(&array[start], &buffer[start], (end - start) * sizeof(elem_t));
+    if (!sample_bucket_sorted(id)) {
+        quickSort(array, start, end - 1);
     }
-    while (j < n2) {
-        array[k++] = right[j++];
+}
+
+// Sample mode: splitters from a random oversample cut the keys into ranges,
+// workers classify their chunks and scatter them into buffer through a
+// per-chunk prefix sum, and idle workers take the buckets off the ring one by
+// one. Every bucket already sits at its final position, so there is no merge.
+void sample_sort(void) {
+    sample_splitters(splitters, array, ARRAY_SIZE, NUM_PROCESSES);
+    int buckets = sample_buckets(splitters);
+    run_chunks(count_chunk_buckets);
+    run_chunks(scatter_chunk_buckets);
+
+    sample_offsets(histograms, NUM_PROCESSES, buckets, 0, bucket_starts);
+    bucket_starts[buckets] = ARRAY_SIZE;
+    proc_pool_run(&pool, sort_bucket, buckets);
+}
+
+// Sorts array with NUM_PROCESSES pool workers, then merges their chunks
+// Counters of parent and workers and the parent's heap bytes are added to
+// map / reduce unless NULL; the workers' memory figures are left in child_reports.
+// Sample mode has no merge, so all of it counts as map phase
+void parallel_sort(PhaseStats *map, PhaseStats *reduce) {
+    phase_mark(&perf, NUM_PROCESSES + 1, NULL);
+
+    if (sort_mode == SORT_SAMPLE) {
+        // ---- Sample Sort ----------------------------------------------------
+        sample_sort();
+        phase_mark(&perf, NUM_PROCESSES + 1, map);
+        return;
     }
 
-    free(left);
-    free(right);
+    // ---- Map Phase ----------------------------------------------------------
+    // Each procress sorts one chunk of array
+    fflush(stdout);
+    run_chunks(chunk_sorting);
+    phase_mark(&perf, NUM_PROCESSES + 1, map);
+
+    // ---- Reduce Phase -------------------------------------------------------
+    // Workers merge all sorted chunks at once into the shared buffer, each
+    // element moving once, then copy the result back into array
+    if (NUM_PROCESSES > 1) {
+        run_chunks(merge_chunk);
+        run_chunks(copy_back_chunk);
+    }
+    phase_mark(&perf, NUM_PROCESSES + 1, reduce);
 }
 
 // Main Method
-int main(void) {
+int main(int argc, char *argv[]) {
+    // Array size, process counts and mode: merge (default) or "sample" for the sample sort
+    Options opts;
+    if (parse_options(argc, argv, &opts, "[merge|sample]") != 0) {
+        return 1;
+    }
+    const char *mode_name = opts.mode ? opts.mode : "merge";
+    if (strcmp(mode_name, "merge") == 0) {
+        sort_mode = SORT_MERGE;
+    } else if (strcmp(mode_name, "sample") == 0) {
+        sort_mode = SORT_SAMPLE;
+    } else {
+        fprintf(stderr, "Unknown sort mode '%s' (expected merge or sample)\n", mode_name);
+        return 1;
+    }
+    verbose = opts.verbose;
+    affinity = opts.affinity;
+    input_dist = opts.dist;
+    input_seed = opts.seed;
+    smaps_enabled = opts.smaps;
+    FILE *report = open_report(&opts);
+
+    // A -i file is shared with the workers: sorted in place with -W, otherwise
+    // copied into array before every run like the generated input
+    size_t file_elems = opts.n;
+    if (opts.input != NULL && opts.write_back) {
+        array = map_file(opts.input, sizeof(elem_t), &file_elems, 1);
+    } else if (opts.input != NULL) {
+        source = map_file(opts.input, sizeof(elem_t), &file_elems, 0);
+    }
+    ARRAY_SIZE = file_elems;
+    opts.n = file_elems;
+
     printf("------------------------------------------------------------------------------------------------------------------------\n");
-    int process_count[] = {1, 2, 4, 8}; // Worker configs
-    double performance[4];              // For storing execution times
-    long memory_usage[4];               // For storing memory usage
+    printf(" - Array: %ld x %s\n", ARRAY_SIZE, ELEM_NAME);
+    if (opts.input != NULL) {
+        printf(" - Input: %s%s\n", opts.input, opts.write_back ? ", sorted in place" : "");
+    } else {
+        printf(" - Input: %s, seed %llu\n", distribution_names[input_dist], (unsigned long long)input_seed);
+    }
+    int *process_count = opts.workers;  // Worker configs
+    BenchResult results[MAX_CONFIGS];   // Timing statistics of each config
+    double *samples = malloc(opts.reps * sizeof(double));
 
     struct timespec c_start, c_end;
 
+    // One shared arena, reserved once for all configs, holds array (unless
+    // sorted in place), the scratch buffer for the reduce phase, the sample
+    // sort tables and a scratch slice per worker plus one for the parent
+    size_t array_elems = (array == NULL) ? (size_t)ARRAY_SIZE : 0;
+    size_t histogram_entries = (size_t)opts.max_workers * 2 * SAMPLE_MAX_RANGES;
+    arena_reserve(&arena, (array_elems + ARRAY_SIZE) * sizeof(elem_t) + histogram_entries * sizeof(long) +
+                  sizeof(SampleSplitters) + (2 * SAMPLE_MAX_RANGES + 1) * sizeof(long) +
+                  (opts.max_workers + 1) * WORKER_ARENA_BYTES + 4 * HUGE_PAGE_SIZE, 1, opts.pages);
+    if (array_elems > 0) {
+        array = arena_take(&arena, array_elems * sizeof(elem_t));
+    }
+    buffer = arena_take(&arena, ARRAY_SIZE * sizeof(elem_t));
+    histograms = arena_take(&arena, histogram_entries * sizeof(long));
+    splitters = arena_take(&arena, sizeof(SampleSplitters));
+    bucket_starts = arena_take(&arena, (2 * SAMPLE_MAX_RANGES + 1) * sizeof(long));
+    worker_arenas = malloc((opts.max_workers + 1) * sizeof(Arena));
+    arena_split(&arena, worker_arenas, opts.max_workers + 1, WORKER_ARENA_BYTES);
+    printf(" - Arena: %zu MB, %s pages%s\n", arena.size >> 20, page_mode_names[arena.pages],
+           opts.prefault ? ", prefaulted" : "");
+    child_reports = mmap(NULL, opts.max_workers * sizeof(ChildReport), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    timings = mmap(NULL, opts.max_workers * sizeof(SliceTiming), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    // Fork workers once, sized for the largest process count, after all
+    // shared memory they use is mapped, and hand each its scratch slice
+    proc_pool_init(&pool, opts.max_workers);
+    proc_pool_run_pinned(&pool, bind_worker_scratch, opts.max_workers);
+    bind_scratch(&worker_arenas[opts.max_workers]);
+
+    // Pin worker i to its CPU, spreading workers over the NUMA nodes
+    if (affinity) {
+        placement_init();
+        for (int i = 0; i < opts.max_workers; i++) {
+            pin_worker(proc_pool_worker_pid(&pool, i), i);
+        }
+        printf(" - Affinity: %d workers over %d CPUs on %d NUMA nodes\n",
+               opts.max_workers, placement.count, placement.nodes);
+    }
+
+    // Counters for the parent (slot 0) and every worker process
+    if (opts.perf) {
+        pid_t pids[opts.max_workers + 1];
+        pids[0] = 0;
+        for (int i = 0; i < opts.max_workers; i++) {
+            pids[i + 1] = proc_pool_worker_pid(&pool, i);
+        }
+        perf_set_open(&perf, pids, opts.max_workers + 1);
+    }
+
     // Loop through the different process counts
-    for (int p = 0; p < 4; p++) {
+    for (int p = 0; p < opts.num_configs; p++) {
         NUM_PROCESSES = process_count[p];
+        if (NUM_PROCESSES > ARRAY_SIZE) {
+            NUM_PROCESSES = ARRAY_SIZE;     // Every process needs at least one element
+        }
         chunk_size = ARRAY_SIZE / NUM_PROCESSES;
+        proc_pool_set_active(&pool, NUM_PROCESSES);
+
+        // Bind each process's chunk of array and buffer to its node
+        if (affinity) {
+            for (int i = 0; i < NUM_PROCESSES; i++) {
+                long length = chunk_start(i + 1) - chunk_start(i);
+                if (!opts.write_back) {
+                    place_pages(&array[chunk_start(i)], length * sizeof(elem_t), worker_node(i));
+                }
+                place_pages(&buffer[chunk_start(i)], length * sizeof(elem_t), worker_node(i));
+            }
+        }
 
         // Label process configurations
         if (NUM_PROCESSES == 1){
@@ -136,107 +356,98 @@ int main(void) {
             printf(" - %d PROCESSES:\n", NUM_PROCESSES);
         }
 
-        // Set up shared memory
-        array = mmap(NULL, ARRAY_SIZE * sizeof(int), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED, -1, 0);
-        shared_mem_usage = mmap(NULL, 8 * sizeof(long), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-
-        // Generate & Fill Array
-        srand(42);
-        for (int i = 0; i < ARRAY_SIZE; i++) {
-            array[i] = rand() % 100;
+        // Fault the pages in before the timed runs instead of on first touch
+        if (opts.prefault) {
+            clock_gettime(CLOCK_MONOTONIC, &c_start);
+            run_chunks(prefault_chunk);
+            clock_gettime(CLOCK_MONOTONIC, &c_end);
+            printf("    - Prefault: %f sec\n", (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9);
         }
 
-        // Print sample of unsorted array
-        printf("    - Before sorting (first 20 elements):\n\t");
-        for (int i = 0; i < 20; i++) {
-            printf("%d ", array[i]);
-        }
-        printf("\n\n");
+        // Warmup runs first, then timed runs, each on a freshly filled array
+        begin_result(&results[p], NUM_PROCESSES, NUM_PROCESSES);
+        for (int rep = -opts.warmups; rep < opts.reps; rep++) {
+            // Generate & Fill Array in parallel; a file sorted in place is only filled once
+            if (!opts.write_back) {
+                run_chunks(fill_chunk);
+            }
 
-        // Record time before sorting
-        clock_gettime(CLOCK_MONOTONIC, &c_start);
-
-        // ---- Map Phase ------------------------------------------------------
-        // Each procress sorts one chunk of array
-        printf("    - Sorting:\n");
-        pid_t pids[NUM_PROCESSES];
-        for (int i = 0; i < NUM_PROCESSES; i++) {
-            pids[i] = fork();
-            if (pids[i] == 0) {
-                int start = i * chunk_size;
-                int end = 0;
-                if (i == NUM_PROCESSES - 1){
-                    end = ARRAY_SIZE - 1;
-                } else {
-                    end = start + chunk_size - 1;
+            // Print sample of unsorted array once per config
+            if (rep == -opts.warmups) {
+                printf("    - Before sorting (first 20 elements):\n\t");
+                for (long i = 0; i < 20 && i < ARRAY_SIZE; i++) {
+                    printf(ELEM_FMT " ", ELEM_PRINT(array[i]));
                 }
+                printf("\n\n");
+                printf((sort_mode == SORT_SAMPLE) ? "    - Sample Sorting:\n" : "    - Sorting:\n");
+            }
 
-                printf("\tProcess %d (PID=%d): sorting %d to %d\n", i, getpid(), start, end);
-                fflush(stdout);
-
-                int local_size = end - start + 1;
-                int *local_array = malloc(local_size * sizeof(int));
-                memcpy(local_array, &array[start], local_size * sizeof(int));
-                quickSort(local_array, 0, local_size - 1);
-                memcpy(&array[start], local_array, local_size * sizeof(int));\
-                free(local_array);
-
-                shared_mem_usage[i] = get_memory_usage();
-                _exit(0);
+            // Start memory window and time before sorting
+            fflush(stdout);
+            reset_peak_rss();
+            clock_gettime(CLOCK_MONOTONIC, &c_start);
 
+            if (rep >= 0) {
+                parallel_sort(&results[p].map, &results[p].reduce);
+            } else {
+                parallel_sort(NULL, NULL);
             }
-        }
 
-        // Wait for all processes to complete
-        for (int i = 0; i < NUM_PROCESSES; i++) {
-            waitpid(pids[i], NULL, 0);
-        }
-        printf("\n\t - All processess finished -\n");
+            // Record time and memory after sorting
+            clock_gettime(CLOCK_MONOTONIC, &c_end);
 
-        // Get total memory usage of processes
-        long total_memory = 0;
-        for (int i = 0; i < NUM_PROCESSES; i++) {
-            total_memory += shared_mem_usage[i];
-        }
-        printf("\n    - Total memory used by children: %ld KB\n", total_memory);
-        memory_usage[p] = total_memory;
-
-        // ---- Reduce Phase ---------------------------------------------------
-        // Merge sorted chunks iteratively into a single sorted array
-        int step = chunk_size;
-        while (step < ARRAY_SIZE) {
-            for (int i = 0; i < ARRAY_SIZE; i += 2 * step) {
-                int low = i;
-                int mid = i + step - 1;
-                int high = (i + 2 * step - 1 < ARRAY_SIZE) ? (i + 2 * step - 1) : (ARRAY_SIZE - 1);
-                merge(array, low, mid, high);
+            if (rep >= 0) {
+                record_run(&results[p], read_peak_rss_kb(), child_reports);
+                if (affinity && sort_mode == SORT_MERGE) {
+                    record_slices(&results[p], timings, NUM_PROCESSES);
+                }
+                samples[rep] = (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9;
             }
-            step *= 2; // Merge larger sections each pass
         }
-
-        // Record time after sorting
-        clock_gettime(CLOCK_MONOTONIC, &c_end);
+        printf("\n\t - All processess finished -\n");
 
         // Print sample after sorting
         printf("\n    - After sorting (first 20 elements):\n\t");
-        for (int i = 0; i < 20; i++) {
-            printf("%d ", array[i]);
+        for (long i = 0; i < 20 && i < ARRAY_SIZE; i++) {
+            printf(ELEM_FMT " ", ELEM_PRINT(array[i]));
         }
         printf("\n\n");
 
-        // Calculate execution time
-        double execution_time = (c_end.tv_sec - c_start.tv_sec) + (c_end.tv_nsec - c_start.tv_nsec) / 1e9;
-        printf("    - Execution Time: %.6f sec", execution_time);
-        performance[p] = execution_time;
+        // Calculate execution time statistics
+        summarize_samples(samples, opts.reps, ARRAY_SIZE, &results[p]);
+        printf("    - Execution Time: %.6f sec (median of %d, p95 %.6f, stddev %.6f)",
+               results[p].median, opts.reps, results[p].p95, results[p].stddev);
+
+        // Memory high water marks of parent and children, heap bytes per run
+        printf("\n\n    - Peak RSS: %ld KB (parent), %ld KB (largest child)",
+               results[p].peak_rss_kb, results[p].child_peak_kb);
+        if (smaps_enabled) {
+            printf("\n    - Children: %ld KB PSS, %ld KB USS", results[p].child_pss_kb, results[p].child_uss_kb);
+        }
+        printf("\n    - Heap Allocated: %lld B map (children included), %lld B reduce",
+               results[p].map.alloc_bytes, results[p].reduce.alloc_bytes);
+        printf("\n    - Page Faults: %lld map (children included), %lld reduce (parent)",
+               results[p].map.faults, results[p].reduce.faults);
 
         printf("\n------------------------------------------------------------------------------------------------------------------------\n");
     }
 
-    printf("\nPerformance Summary:\n");
-    printf("Processes  Time (s)\tMem Usage (KB)\n");
-    for (int p = 0; p < 4; p++) {
-        printf("%d\t   %.6f\t%ld\n", process_count[p], performance[p], memory_usage[p]);
-    }
+    fflush(stdout);
+    const char *mode_names[] = {"merge", "sample"};
+    print_report(report, &opts, "parallel_sort_multiprocessing", mode_names[sort_mode], "Processes", results);
 
+    free(samples);
+    perf_set_close(&perf);
+    proc_pool_destroy(&pool);
+    if (opts.write_back) {
+        munmap(array, ARRAY_SIZE * sizeof(elem_t));
+    }
+    munmap(child_reports, opts.max_workers * sizeof(ChildReport));
+    munmap(timings, opts.max_workers * sizeof(SliceTiming));
+    arena_release(&arena);
+    free(worker_arenas);
+    if (source != NULL) {
+        munmap(source, ARRAY_SIZE * sizeof(elem_t));
+    }
     return 0;
 }
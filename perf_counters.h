@@ -0,0 +1,181 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Per-thread / per-process hardware and software counters via perf_event_open
+// A PerfSet holds one counter group per monitored thread. perf_set_mark() reads
+// them all and adds what was counted since the previous mark to a phase total,
+// so a phase is bracketed by two marks:
+//     perf_set_mark(&set, n, NULL);           // baseline
+//     ... map phase ...
+//     perf_set_mark(&set, n, &map_total);
+// Events the kernel or CPU does not offer (e.g. hardware events in a VM) stay
+// unavailable and are reported as empty rather than failing the run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <linux/perf_event.h>
+
+// Counted Events
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_LLC_MISSES 2
+#define PERF_BRANCH_MISSES 3
+#define PERF_CONTEXT_SWITCHES 4
+#define PERF_PAGE_FAULTS 5
+#define PERF_EVENTS 6
+
+static const char *const perf_event_names[PERF_EVENTS] = {
+    "cycles", "instructions", "llc_misses", "branch_misses", "context_switches", "page_faults"
+};
+
+// Counts of one phase; bit e of available is set if event e was counted
+typedef struct {
+    long long count[PERF_EVENTS];
+    unsigned available;
+} PerfSample;
+
+// Open counters of one thread, fd -1 where unavailable
+typedef struct {
+    int fd[PERF_EVENTS];
+} PerfCounters;
+
+typedef struct {
+    int count;                      // Monitored threads, 0 when counters are off
+    PerfCounters *counters;
+    PerfSample *last;               // Reading at previous mark
+} PerfSet;
+
+// Opens one counting event for tid (0 = calling thread) on any CPU
+// Kernel-side counts are tried first, then user space only for stricter
+// perf_event_paranoid settings
+static inline int perf_open_event(unsigned type, unsigned long long config, pid_t tid) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = syscall(SYS_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0) {
+        attr.exclude_kernel = 1;
+        fd = syscall(SYS_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    }
+    return fd;
+}
+
+// Opens all events for tid
+static inline void perf_open(PerfCounters *counters, pid_t tid) {
+    static const unsigned types[PERF_EVENTS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE, PERF_TYPE_SOFTWARE
+    };
+    static const unsigned long long configs[PERF_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_SW_CONTEXT_SWITCHES,
+        PERF_COUNT_SW_PAGE_FAULTS
+    };
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        counters->fd[e] = perf_open_event(types[e], configs[e], tid);
+    }
+}
+
+// Reads current totals, scaled up if the event was multiplexed off the PMU
+static inline void perf_read(const PerfCounters *counters, PerfSample *sample) {
+    sample->available = 0;
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        unsigned long long value[3];        // count, time enabled, time running
+        sample->count[e] = 0;
+        if (counters->fd[e] < 0 || read(counters->fd[e], value, sizeof(value)) != sizeof(value)) {
+            continue;
+        }
+        if (value[2] != 0 && value[2] < value[1]) {
+            value[0] = (unsigned long long)((double)value[0] * value[1] / value[2]);
+        }
+        sample->count[e] = (long long)value[0];
+        sample->available |= 1u << e;
+    }
+}
+
+static inline void perf_close(PerfCounters *counters) {
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        if (counters->fd[e] >= 0) {
+            close(counters->fd[e]);
+        }
+    }
+}
+
+static inline void perf_clear(PerfSample *sample) {
+    memset(sample, 0, sizeof(*sample));
+}
+
+// total += sample
+static inline void perf_add(PerfSample *total, const PerfSample *sample) {
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        total->count[e] += sample->count[e];
+    }
+    total->available |= sample->available;
+}
+
+// Divides every count by runs, giving a per-run average
+static inline void perf_average(PerfSample *sample, int runs) {
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        sample->count[e] /= runs;
+    }
+}
+
+// Instructions per cycle, negative if either was not counted
+static inline double perf_ipc(const PerfSample *sample) {
+    unsigned needed = (1u << PERF_CYCLES) | (1u << PERF_INSTRUCTIONS);
+    if ((sample->available & needed) != needed || sample->count[PERF_CYCLES] == 0) {
+        return -1;
+    }
+    return (double)sample->count[PERF_INSTRUCTIONS] / sample->count[PERF_CYCLES];
+}
+
+// Opens counters for each of the n thread ids in tids (0 = calling thread)
+static inline void perf_set_open(PerfSet *set, const pid_t *tids, int n) {
+    set->count = n;
+    set->counters = malloc(n * sizeof(PerfCounters));
+    set->last = calloc(n, sizeof(PerfSample));
+    for (int i = 0; i < n; i++) {
+        perf_open(&set->counters[i], tids[i]);
+    }
+}
+
+// Reads the first n threads of set and adds their counts since the previous
+// mark to total; a NULL total only sets the baseline
+static inline void perf_set_mark(PerfSet *set, int n, PerfSample *total) {
+    n = (n < set->count) ? n : set->count;
+    for (int i = 0; i < n; i++) {
+        PerfSample now;
+        perf_read(&set->counters[i], &now);
+        if (total != NULL) {
+            for (int e = 0; e < PERF_EVENTS; e++) {
+                total->count[e] += now.count[e] - set->last[i].count[e];
+            }
+            total->available |= now.available;
+        }
+        set->last[i] = now;
+    }
+}
+
+static inline void perf_set_close(PerfSet *set) {
+    for (int i = 0; i < set->count; i++) {
+        perf_close(&set->counters[i]);
+    }
+    free(set->counters);
+    free(set->last);
+    set->count = 0;
+}
+
+#endif
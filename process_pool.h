@@ -0,0 +1,310 @@
+#ifndef PROCESS_POOL_H
+#define PROCESS_POOL_H
+
+// Persistent pool of forked worker processes shared by the multiprocessing programs
+// Workers are forked once and take tasks from a bounded single-producer /
+// multi-consumer ring in a MAP_SHARED region; idle workers sleep on a futex.
+// Only memory mapped MAP_SHARED before proc_pool_init() is visible to both
+// sides afterwards. Globals are copied at fork, so a task gets the id and
+// count it needs to locate its work instead of reading the parent's globals.
+// proc_pool_run_pinned() hands task i to worker i through its own mailbox
+// instead, for work tied to a worker's CPU or memory. A pool that outlives
+// many jobs can also publish a context pointer into shared memory with
+// proc_pool_set_context(); its tasks read it back with proc_pool_context().
+// A waiting parent wakes up every PROC_POLL_MS to check that no worker has died
+// (a crash or the OOM killer), since that worker's task would never finish.
+
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define PROC_RING_SIZE 256          // Ring slots (power of 2)
+#define PROC_POLL_MS 100            // Dead worker check interval of a waiting parent
+
+// Runs task id of count tasks in a worker process
+typedef void (*proc_task_fn)(int id, int count);
+
+// Ring slot; seq is the ring position it may be written at (free) or that
+// position + 1 once the task is published
+typedef struct {
+    _Atomic uint32_t seq;
+    proc_task_fn fn;
+    int id;
+    int count;
+} ProcSlot;
+
+// Task for one specific worker
+typedef struct {
+    _Alignas(64) _Atomic int full;
+    proc_task_fn fn;
+    int id;
+    int count;
+} ProcMailbox;
+
+// Lives in the MAP_SHARED region seen by parent and workers
+typedef struct {
+    _Alignas(64) _Atomic uint32_t tail;     // Next ring position to claim
+    _Alignas(64) _Atomic uint32_t signal;   // Futex, bumped on new tasks, set_active and shutdown
+    _Alignas(64) _Atomic uint32_t finished; // Futex, tasks completed so far
+    _Atomic int active;                     // Only workers below this index take tasks
+    _Atomic int shutdown;
+    void *context;                          // Set by proc_pool_set_context()
+    ProcSlot slots[PROC_RING_SIZE];
+    ProcMailbox pinned[];                   // One per worker
+} ProcShared;
+
+typedef struct {
+    ProcShared *shared;
+    size_t shared_size;
+    pid_t *pids;
+    int num_workers;
+    uint32_t head;                  // Next ring position to publish (parent only)
+} ProcessPool;
+
+// Context of the pool whose task this worker process is running
+static __thread void *proc_current_context;
+
+static inline void futex_wait(_Atomic uint32_t *word, uint32_t expected) {
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+// futex_wait() that also returns after ms milliseconds
+static inline void futex_wait_ms(_Atomic uint32_t *word, uint32_t expected, long ms) {
+    struct timespec timeout = {ms / 1000, (ms % 1000) * 1000000L};
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, expected, &timeout, NULL, 0);
+}
+
+static inline void futex_wake(_Atomic uint32_t *word, int waiters) {
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, waiters, NULL, NULL, 0);
+}
+
+// Consumer: claims the oldest published task, 0 if the ring is empty
+static inline int ring_take(ProcShared *shared, ProcSlot *task) {
+    uint32_t pos = atomic_load_explicit(&shared->tail, memory_order_relaxed);
+    while (1) {
+        ProcSlot *slot = &shared->slots[pos & (PROC_RING_SIZE - 1)];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - (pos + 1));
+        if (diff < 0) {
+            return 0;
+        }
+        if (diff > 0) {
+            // Another worker claimed pos meanwhile
+            pos = atomic_load_explicit(&shared->tail, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&shared->tail, &pos, pos + 1,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            task->fn = slot->fn;
+            task->id = slot->id;
+            task->count = slot->count;
+
+            // Hand the slot back to the producer for its next lap
+            atomic_store_explicit(&slot->seq, pos + PROC_RING_SIZE, memory_order_release);
+            return 1;
+        }
+    }
+}
+
+// Bumps signal and wakes every sleeping worker
+static inline void proc_pool_signal(ProcessPool *pool) {
+    atomic_fetch_add_explicit(&pool->shared->signal, 1, memory_order_release);
+    futex_wake(&pool->shared->signal, INT_MAX);
+}
+
+// Exits with an error if a worker has died; the parent would wait for its
+// task forever otherwise
+static inline void proc_pool_check_workers(ProcessPool *pool) {
+    for (int i = 0; i < pool->num_workers; i++) {
+        int status;
+        if (waitpid(pool->pids[i], &status, WNOHANG) != pool->pids[i]) {
+            continue;
+        }
+        if (WIFSIGNALED(status)) {
+            fprintf(stderr, "Worker %d (PID=%d) was killed by signal %d (%s)\n", i, pool->pids[i],
+                    WTERMSIG(status), strsignal(WTERMSIG(status)));
+        } else {
+            fprintf(stderr, "Worker %d (PID=%d) exited with status %d\n", i, pool->pids[i], WEXITSTATUS(status));
+        }
+        exit(1);
+    }
+}
+
+// Producer: publishes fn(id, count); a full ring wakes the workers to drain it
+static inline void ring_put(ProcessPool *pool, proc_task_fn fn, int id, int count) {
+    ProcSlot *slot = &pool->shared->slots[pool->head & (PROC_RING_SIZE - 1)];
+    for (int spins = 1; atomic_load_explicit(&slot->seq, memory_order_acquire) != pool->head; spins++) {
+        proc_pool_signal(pool);
+        sched_yield();
+        if (spins % 1024 == 0) {
+            proc_pool_check_workers(pool);
+        }
+    }
+    slot->fn = fn;
+    slot->id = id;
+    slot->count = count;
+    atomic_store_explicit(&slot->seq, pool->head + 1, memory_order_release);
+    pool->head++;
+}
+
+// Worker loop: run tasks while any can be claimed, sleep on signal otherwise
+// Reading signal before the ring means a task published after the check
+// changes signal and makes futex_wait return at once
+static inline void proc_worker(ProcShared *shared, int index) {
+    while (1) {
+        uint32_t seen = atomic_load_explicit(&shared->signal, memory_order_acquire);
+        if (atomic_load(&shared->shutdown)) {
+            break;
+        }
+
+        ProcSlot task;
+        ProcMailbox *mailbox = &shared->pinned[index];
+        if (atomic_load_explicit(&mailbox->full, memory_order_acquire)) {
+            proc_current_context = shared->context;
+            mailbox->fn(mailbox->id, mailbox->count);
+            atomic_store(&mailbox->full, 0);
+            atomic_fetch_add_explicit(&shared->finished, 1, memory_order_release);
+            futex_wake(&shared->finished, 1);
+            continue;
+        }
+        if (index < atomic_load(&shared->active) && ring_take(shared, &task)) {
+            proc_current_context = shared->context;
+            task.fn(task.id, task.count);
+            atomic_fetch_add_explicit(&shared->finished, 1, memory_order_release);
+            futex_wake(&shared->finished, 1);
+            continue;
+        }
+        futex_wait(&shared->signal, seen);
+    }
+}
+
+// Forks num_workers sleeping workers, all active
+// Set up every shared mapping and global the tasks read before calling this
+static inline void proc_pool_init(ProcessPool *pool, int num_workers) {
+    pool->shared_size = sizeof(ProcShared) + num_workers * sizeof(ProcMailbox);
+    pool->shared = mmap(NULL, pool->shared_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (pool->shared == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    atomic_init(&pool->shared->tail, 0);
+    atomic_init(&pool->shared->signal, 0);
+    atomic_init(&pool->shared->finished, 0);
+    atomic_init(&pool->shared->active, num_workers);
+    atomic_init(&pool->shared->shutdown, 0);
+    pool->shared->context = NULL;
+    for (uint32_t i = 0; i < PROC_RING_SIZE; i++) {
+        atomic_init(&pool->shared->slots[i].seq, i);
+    }
+    for (int i = 0; i < num_workers; i++) {
+        atomic_init(&pool->shared->pinned[i].full, 0);
+    }
+    pool->pids = malloc(num_workers * sizeof(pid_t));
+    pool->num_workers = num_workers;
+    pool->head = 0;
+
+    fflush(stdout);                 // Workers must not inherit buffered output
+    pid_t parent = getpid();
+    for (int i = 0; i < num_workers; i++) {
+        pool->pids[i] = fork();
+        if (pool->pids[i] < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pool->pids[i] == 0) {
+            // Do not outlive the parent if it dies without proc_pool_destroy()
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != parent) {
+                _exit(1);
+            }
+            proc_worker(pool->shared, i);
+            _exit(0);
+        }
+    }
+}
+
+// Limits task execution to the first n workers; call while the pool is idle
+static inline void proc_pool_set_active(ProcessPool *pool, int n) {
+    atomic_store(&pool->shared->active, (n < pool->num_workers) ? n : pool->num_workers);
+    proc_pool_signal(pool);
+}
+
+// Publishes context to the tasks run from now on; call while the pool is idle
+// It must point into memory mapped MAP_SHARED before proc_pool_init(), which
+// sits at the same address in every worker
+static inline void proc_pool_set_context(ProcessPool *pool, void *context) {
+    pool->shared->context = context;
+}
+
+// Context of the running task's pool, in a worker process
+static inline void *proc_pool_context(void) {
+    return proc_current_context;
+}
+
+// Process id of worker i, e.g. for attaching perf counters
+static inline pid_t proc_pool_worker_pid(ProcessPool *pool, int i) {
+    return pool->pids[i];
+}
+
+// Sleeps until the workers have finished target tasks in total, exits with an
+// error if a worker dies meanwhile
+static inline void proc_pool_wait(ProcessPool *pool, uint32_t target) {
+    uint32_t done;
+    while ((done = atomic_load_explicit(&pool->shared->finished, memory_order_acquire)) != target) {
+        futex_wait_ms(&pool->shared->finished, done, PROC_POLL_MS);
+        if (atomic_load_explicit(&pool->shared->finished, memory_order_acquire) == done) {
+            proc_pool_check_workers(pool);
+        }
+    }
+}
+
+// Runs fn(id, n) for every id in [0, n) and waits for all of them (fork-join step)
+static inline void proc_pool_run(ProcessPool *pool, proc_task_fn fn, int n) {
+    uint32_t target = atomic_load(&pool->shared->finished) + (uint32_t)n;
+    for (int i = 0; i < n; i++) {
+        ring_put(pool, fn, i, n);
+    }
+    proc_pool_signal(pool);
+
+    proc_pool_wait(pool, target);
+}
+
+// Runs fn(i, n) on worker i for every i < n and waits for all of them
+static inline void proc_pool_run_pinned(ProcessPool *pool, proc_task_fn fn, int n) {
+    uint32_t target = atomic_load(&pool->shared->finished) + (uint32_t)n;
+    for (int i = 0; i < n; i++) {
+        ProcMailbox *mailbox = &pool->shared->pinned[i];
+        mailbox->fn = fn;
+        mailbox->id = i;
+        mailbox->count = n;
+        atomic_store_explicit(&mailbox->full, 1, memory_order_release);
+    }
+    proc_pool_signal(pool);
+    proc_pool_wait(pool, target);
+}
+
+// Stops and reaps the workers, then unmaps the ring
+static inline void proc_pool_destroy(ProcessPool *pool) {
+    atomic_store(&pool->shared->shutdown, 1);
+    proc_pool_signal(pool);
+    for (int i = 0; i < pool->num_workers; i++) {
+        waitpid(pool->pids[i], NULL, 0);
+    }
+    munmap(pool->shared, pool->shared_size);
+    free(pool->pids);
+}
+
+#endif
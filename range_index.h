@@ -0,0 +1,144 @@
+#ifndef RANGE_INDEX_H
+#define RANGE_INDEX_H
+
+// Range max / min index over an array that changes rarely, if at all
+// A block summary tree: level 0 is the array itself and entry j of level
+// k + 1 holds the max and min of entries j*F .. j*F + F - 1 of level k, F
+// being one cache line of elements. A query folds the partial blocks at both
+// ends of [lo, hi] and moves up a level for the whole blocks between them,
+// so it reads at most two cache lines per level, log_F(n) levels in all. A
+// point update recomputes one block per level on its way up and stops as soon
+// as a summary is unchanged. Levels are built bottom up, each one split over
+// the workers by the caller; the summaries add about 2 / (F - 1) of the
+// array's size and come from the caller's arena, so they get its page size.
+// Queries may run concurrently, updates may not.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "elem_type.h"
+#include "max_kernels.h"
+#include "arena.h"
+
+#define RANGE_FANOUT (CACHE_LINE / (int)sizeof(elem_t))   // Entries summarized by one parent
+#define RANGE_MAX_LEVELS 32
+
+typedef struct {
+    elem_t max;
+    elem_t min;
+} RangeResult;
+
+typedef struct {
+    int levels;                             // Summary levels above the array
+    size_t size[RANGE_MAX_LEVELS + 1];      // Entries of each level, size[0] is the array's
+    elem_t *max[RANGE_MAX_LEVELS + 1];      // max[0] and min[0] are the array itself
+    elem_t *min[RANGE_MAX_LEVELS + 1];
+} RangeIndex;
+
+// Arena bytes the summaries over n elements need, alignment of every level included
+static inline size_t range_index_arena_bytes(size_t n) {
+    size_t bytes = 0;
+    for (size_t size = n; size > 1;) {
+        size = (size + RANGE_FANOUT - 1) / RANGE_FANOUT;
+        size_t level = size * sizeof(elem_t);
+        bytes += 2 * (level + ((level >= HUGE_PAGE_SIZE) ? HUGE_PAGE_SIZE : ARENA_ALIGN));
+    }
+    return bytes;
+}
+
+// Carves the summary levels over array[0..n) from arena, which must have
+// range_index_arena_bytes(n) left; they are released with the arena, and
+// nothing is computed until every level has been summarized with
+// range_summarize()
+static inline void range_index_init(RangeIndex *index, elem_t *array, size_t n, Arena *arena) {
+    index->levels = 0;
+    index->size[0] = n;
+    index->max[0] = array;
+    index->min[0] = array;
+    while (index->size[index->levels] > 1) {
+        int level = ++index->levels;
+        index->size[level] = (index->size[level - 1] + RANGE_FANOUT - 1) / RANGE_FANOUT;
+        index->max[level] = arena_take(arena, index->size[level] * sizeof(elem_t));
+        index->min[level] = arena_take(arena, index->size[level] * sizeof(elem_t));
+    }
+}
+
+// Summary bytes on top of the array
+static inline size_t range_index_bytes(const RangeIndex *index) {
+    size_t entries = 0;
+    for (int level = 1; level <= index->levels; level++) {
+        entries += index->size[level];
+    }
+    return 2 * entries * sizeof(elem_t);
+}
+
+// Computes entries [first, last) of level from the level below; full blocks
+// have a constant trip count, so the compiler vectorizes them
+static inline void range_summarize(RangeIndex *index, int level, size_t first, size_t last) {
+    const elem_t *max_below = index->max[level - 1];
+    const elem_t *min_below = index->min[level - 1];
+    size_t below = index->size[level - 1];
+    for (size_t j = first; j < last; j++) {
+        size_t start = j * RANGE_FANOUT;
+        elem_t max = max_below[start];
+        elem_t min = min_below[start];
+        if (start + RANGE_FANOUT <= below) {
+            for (int i = 1; i < RANGE_FANOUT; i++) {
+                max = (max_below[start + i] > max) ? max_below[start + i] : max;
+                min = (min_below[start + i] < min) ? min_below[start + i] : min;
+            }
+        } else {
+            for (size_t i = start + 1; i < below; i++) {
+                max = (max_below[i] > max) ? max_below[i] : max;
+                min = (min_below[i] < min) ? min_below[i] : min;
+            }
+        }
+        index->max[level][j] = max;
+        index->min[level][j] = min;
+    }
+}
+
+// Max and min of array[lo..hi], lo <= hi < n
+static inline RangeResult range_query(const RangeIndex *index, size_t lo, size_t hi) {
+    RangeResult result = {index->max[0][lo], index->min[0][lo]};
+    for (int level = 0;; level++) {
+        const elem_t *max = index->max[level];
+        const elem_t *min = index->min[level];
+
+        // Short ranges and the root level are folded directly
+        if (hi - lo < 2 * RANGE_FANOUT || level == index->levels) {
+            for (size_t i = lo; i <= hi; i++) {
+                result.max = (max[i] > result.max) ? max[i] : result.max;
+                result.min = (min[i] < result.min) ? min[i] : result.min;
+            }
+            return result;
+        }
+
+        // Partial blocks at both ends, then the whole blocks one level up
+        for (; lo % RANGE_FANOUT != 0; lo++) {
+            result.max = (max[lo] > result.max) ? max[lo] : result.max;
+            result.min = (min[lo] < result.min) ? min[lo] : result.min;
+        }
+        for (; (hi + 1) % RANGE_FANOUT != 0; hi--) {
+            result.max = (max[hi] > result.max) ? max[hi] : result.max;
+            result.min = (min[hi] < result.min) ? min[hi] : result.min;
+        }
+        lo /= RANGE_FANOUT;
+        hi = (hi + 1) / RANGE_FANOUT - 1;
+    }
+}
+
+// Sets array[i] to value and repairs the summaries above it
+static inline void range_update(RangeIndex *index, size_t i, elem_t value) {
+    index->max[0][i] = value;
+    for (int level = 1; level <= index->levels; level++) {
+        i /= RANGE_FANOUT;
+        elem_t old_max = index->max[level][i];
+        elem_t old_min = index->min[level][i];
+        range_summarize(index, level, i, i + 1);
+        if (index->max[level][i] == old_max && index->min[level][i] == old_min) {
+            return;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef SELECT_KERNELS_H
+#define SELECT_KERNELS_H
+
+// Selection kernels shared by the max value programs
+// Top-k: every worker keeps a bounded min-heap of the k largest values it has
+// seen. Its root is the threshold a new value must beat, tested for a whole
+// block at once in a loop the compiler vectorizes, so once the heap is warm
+// most blocks cost one compare per element. The reduce step pushes every
+// worker's heap into one; its root is then the k-th largest element.
+// Order statistics: Floyd-Rivest style. Two order statistics of a random
+// sample bracket the wanted rank; one parallel pass counts the elements up to
+// each end of the bracket and copies the few strictly inside it, and a
+// quickselect on those copies finds the answer. The array is never modified,
+// so a read-only -i mapping works.
+
+#include <math.h>
+#include <stddef.h>
+#include "elem_type.h"
+#include "data_gen.h"
+#include "max_kernels.h"
+
+#define TOPK_BLOCK 64               // Elements tested against the threshold at once
+#define SELECT_SAMPLE 16384         // Sample drawn to bracket a rank
+#define SELECT_GAP 4.0              // Bracket half width in sample standard deviations
+#define SELECT_SEED 0x7E1EC7u       // Stream of the sampled positions
+
+// ---- Top-k ------------------------------------------------------------------
+
+// Min-heap of at most k values in caller storage (shared for the processes)
+typedef struct {
+    size_t k;
+    size_t size;
+    elem_t *items;
+} TopK;
+
+static inline void topk_init(TopK *heap, size_t k, elem_t *items) {
+    heap->k = k;
+    heap->size = 0;
+    heap->items = items;
+}
+
+// Restores heap order below root for the first size items
+static inline void topk_sift_down(elem_t *items, size_t size, size_t root) {
+    elem_t value = items[root];
+    while (2 * root + 1 < size) {
+        size_t child = 2 * root + 1;
+        if (child + 1 < size && items[child + 1] < items[child]) {
+            child++;
+        }
+        if (!(items[child] < value)) {
+            break;
+        }
+        items[root] = items[child];
+        root = child;
+    }
+    items[root] = value;
+}
+
+// Offers x to the heap, keeping the k largest values seen
+static inline void topk_push(TopK *heap, elem_t x) {
+    if (heap->size < heap->k) {
+        size_t i = heap->size++;
+        while (i > 0 && x < heap->items[(i - 1) / 2]) {
+            heap->items[i] = heap->items[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap->items[i] = x;
+    } else if (x > heap->items[0]) {
+        heap->items[0] = x;
+        topk_sift_down(heap->items, heap->size, 0);
+    }
+}
+
+// Offers data[0..n) to the heap; blocks with no value above the threshold
+// are skipped after one branch-free pass
+static inline void topk_scan(TopK *heap, const elem_t *data, size_t n) {
+    size_t i = 0;
+    while (i < n && heap->size < heap->k) {
+        topk_push(heap, data[i++]);
+    }
+    for (; i + TOPK_BLOCK <= n; i += TOPK_BLOCK) {
+        elem_t threshold = heap->items[0];
+        int above = 0;
+        for (int j = 0; j < TOPK_BLOCK; j++) {
+            above |= data[i + j] > threshold;
+        }
+        if (above) {
+            for (int j = 0; j < TOPK_BLOCK; j++) {
+                topk_push(heap, data[i + j]);
+            }
+        }
+    }
+    for (; i < n; i++) {
+        topk_push(heap, data[i]);
+    }
+}
+
+// Folds other's values into heap (reduce step)
+static inline void topk_merge(TopK *heap, const TopK *other) {
+    for (size_t i = 0; i < other->size; i++) {
+        topk_push(heap, other->items[i]);
+    }
+}
+
+// Sorts the items largest first; the heap is no longer usable afterwards
+static inline void topk_sort(TopK *heap) {
+    for (size_t end = heap->size; end > 1; end--) {
+        elem_t smallest = heap->items[0];
+        heap->items[0] = heap->items[end - 1];
+        heap->items[end - 1] = smallest;
+        topk_sift_down(heap->items, end - 1, 0);
+    }
+}
+
+// ---- Order Statistics -------------------------------------------------------
+// Ranks count from 0, the smallest element
+
+// Element counts of one worker's pass for a bracket [low, high]
+typedef struct {
+    _Alignas(CACHE_LINE) size_t below;      // Elements < low
+    size_t upto_low;                        // Elements <= low
+    size_t inside;                          // low < element < high, copied out
+    size_t upto_high;                       // Elements <= high
+} SelectCounts;
+
+// Rank of percentile pct of n elements (lower nearest rank)
+static inline size_t percentile_rank(size_t n, double pct) {
+    return (size_t)(pct / 100.0 * (double)(n - 1));
+}
+
+// Quickselect: the element of rank r in data[0..n), which it reorders
+static inline elem_t select_nth(elem_t *data, long n, long r) {
+    long low = 0;
+    long high = n - 1;
+    while (low < high) {
+        // Median of three pivot, three-way partition so duplicates end it early
+        long mid = low + (high - low) / 2;
+        elem_t a = data[low], b = data[mid], c = data[high];
+        elem_t pivot = (a < b) ? ((b < c) ? b : (a < c) ? c : a) : ((a < c) ? a : (b < c) ? c : b);
+        long lt = low, gt = high, i = low;
+        while (i <= gt) {
+            elem_t x = data[i];
+            if (x < pivot) {
+                data[i++] = data[lt];
+                data[lt++] = x;
+            } else if (x > pivot) {
+                data[i] = data[gt];
+                data[gt--] = x;
+            } else {
+                i++;
+            }
+        }
+        if (r < lt) {
+            high = lt - 1;
+        } else if (r > gt) {
+            low = gt + 1;
+        } else {
+            return pivot;
+        }
+    }
+    return data[r];
+}
+
+// Picks a bracket [*low, *high] around rank r of the n elements of array
+// from a random sample, sample[0..SELECT_SAMPLE) being scratch space; the
+// bracket misses r with a probability of about exp(-SELECT_GAP^2 / 2)
+static inline void select_bracket(const elem_t *array, size_t n, size_t r, elem_t *sample, elem_t *low, elem_t *high) {
+    for (size_t i = 0; i < SELECT_SAMPLE; i++) {
+        sample[i] = array[counter_random(SELECT_SEED, i) % n];
+    }
+    double position = (double)r / (double)n * SELECT_SAMPLE;
+    double gap = SELECT_GAP * sqrt(SELECT_SAMPLE);
+    double first = position - gap;
+    double last = position + gap;
+    *low = select_nth(sample, SELECT_SAMPLE, (first < 0) ? 0 : (long)first);
+    *high = select_nth(sample, SELECT_SAMPLE, (last > SELECT_SAMPLE - 1) ? SELECT_SAMPLE - 1 : (long)last);
+}
+
+// One worker's pass over data[0..n): counts against [low, high] and copies
+// the elements strictly inside to out, which has room for n
+// The copy is unconditional and only the count advances, so it never branches
+static inline void select_scan(const elem_t *data, size_t n, elem_t low, elem_t high, SelectCounts *counts, elem_t *out) {
+    size_t below = 0, upto_low = 0, inside = 0, upto_high = 0;
+    for (size_t i = 0; i < n; i++) {
+        elem_t x = data[i];
+        below += x < low;
+        upto_low += x <= low;
+        upto_high += x <= high;
+        out[inside] = x;
+        inside += (x > low) & (x < high);
+    }
+    counts->below = below;
+    counts->upto_low = upto_low;
+    counts->inside = inside;
+    counts->upto_high = upto_high;
+}
+
+// Adds a worker's counts to total
+static inline void select_add(SelectCounts *total, const SelectCounts *counts) {
+    total->below += counts->below;
+    total->upto_low += counts->upto_low;
+    total->inside += counts->inside;
+    total->upto_high += counts->upto_high;
+}
+
+// Answers rank r from the summed counts and the inside elements gathered in
+// candidates: returns 1 and sets *result, or returns 0 after moving the
+// bracket to the side r fell on, bounded by the array's min / max, so the
+// next pass cannot miss
+static inline int select_resolve(const SelectCounts *total, elem_t *candidates, size_t r, elem_t min, elem_t max,
+                                 elem_t *low, elem_t *high, elem_t *result) {
+    if (r < total->below) {
+        *high = *low;
+        *low = min;
+        return 0;
+    }
+    if (r < total->upto_low) {
+        *result = *low;
+        return 1;
+    }
+    if (r < total->upto_low + total->inside) {
+        *result = select_nth(candidates, (long)total->inside, (long)(r - total->upto_low));
+        return 1;
+    }
+    if (r < total->upto_high) {
+        *result = *high;
+        return 1;
+    }
+    *low = *high;
+    *high = max;
+    return 0;
+}
+
+#endif
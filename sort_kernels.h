@@ -0,0 +1,314 @@
+#ifndef SORT_KERNELS_H
+#define SORT_KERNELS_H
+
+// Sort kernels shared by the sort programs
+// An introsort (three-way quicksort with median-of-3 / ninther pivots,
+// heapsort past 2*log2(n) levels, insertion sort on small ranges) sorts any
+// range of an elem_t array in place. parallelQuickSort() runs the same sort
+// on a thread pool, spawning large partitions as stealable tasks. Nothing
+// here reads program globals, and every comparison is on elem_t, fixed at
+// compile time, so the kernels inline without comparator calls.
+// The sample sort helpers split an array into key ranges that can be sorted
+// independently, so sorted buckets need no merge afterwards.
+
+#include <stdlib.h>
+#include "elem_type.h"
+#include "data_gen.h"
+#include "thread_pool.h"
+#include "arena.h"
+
+#define PARALLEL_SORT_CUTOFF 4096   // Partitions larger than this become stealable tasks
+
+// Introsort tuning
+#define INSERTION_SORT_CUTOFF 16    // Ranges this small are insertion sorted
+#define NINTHER_CUTOFF 128          // Ranges this large use ninther pivots
+
+// Sample sort tuning
+#define SAMPLE_MAX_RANGES 256       // Splitter tree size limit (power of 2)
+#define SAMPLE_OVERSAMPLING 32      // Samples drawn per range
+#define SAMPLE_SEED 0x5A3D7E11u     // Stream of the sampled positions
+
+// Swaps two array elements
+static inline void swap(elem_t *array, long a, long b) {
+    elem_t temp = array[a];
+    array[a] = array[b];
+    array[b] = temp;
+}
+
+// Insertion sort for small ranges
+static inline void insertionSort(elem_t *array, long low, long high) {
+    for (long i = low + 1; i <= high; i++) {
+        elem_t key = array[i];
+        long j = i - 1;
+        while (j >= low && array[j] > key) {
+            array[j + 1] = array[j];
+            j--;
+        }
+        array[j + 1] = key;
+    }
+}
+
+// Restores max-heap order below root for heap stored at array[low..low+size)
+static inline void siftDown(elem_t *array, long low, long root, long size) {
+    while (2 * root + 1 < size) {
+        long child = 2 * root + 1;
+        if (child + 1 < size && array[low + child + 1] > array[low + child]) {
+            child++;
+        }
+        if (array[low + root] >= array[low + child]) {
+            return;
+        }
+        swap(array, low + root, low + child);
+        root = child;
+    }
+}
+
+// Heapsort fallback for ranges where quicksort recursed too deep
+static inline void heapSort(elem_t *array, long low, long high) {
+    long size = high - low + 1;
+    for (long root = size / 2 - 1; root >= 0; root--) {
+        siftDown(array, low, root, size);
+    }
+    for (long end = size - 1; end > 0; end--) {
+        swap(array, low, low + end);
+        siftDown(array, low, 0, end);
+    }
+}
+
+// Returns index of median of three elements
+static inline long medianOfThree(elem_t *array, long a, long b, long c) {
+    if (array[a] < array[b]) {
+        if (array[b] < array[c]) return b;
+        return (array[a] < array[c]) ? c : a;
+    }
+    if (array[a] < array[c]) return a;
+    return (array[b] < array[c]) ? c : b;
+}
+
+// Picks pivot with median-of-3, or Tukey's ninther on large ranges
+static inline long choosePivot(elem_t *array, long low, long high) {
+    long mid = low + (high - low) / 2;
+    if (high - low + 1 < NINTHER_CUTOFF) {
+        return medianOfThree(array, low, mid, high);
+    }
+    long eighth = (high - low + 1) / 8;
+    long a = medianOfThree(array, low, low + eighth, low + 2 * eighth);
+    long b = medianOfThree(array, mid - eighth, mid, mid + eighth);
+    long c = medianOfThree(array, high - 2 * eighth, high - eighth, high);
+    return medianOfThree(array, a, b, c);
+}
+
+// Dutch flag partition: [low, lt) < pivot, [lt, gt] == pivot, (gt, high] > pivot
+static inline void partition3(elem_t *array, long low, long high, long *lt_out, long *gt_out) {
+    elem_t pivot = array[choosePivot(array, low, high)];
+    long lt = low;
+    long gt = high;
+    long i = low;
+    while (i <= gt) {
+        if (array[i] < pivot) {
+            swap(array, lt++, i++);
+        } else if (array[i] > pivot) {
+            swap(array, i, gt--);
+        } else {
+            i++;
+        }
+    }
+    *lt_out = lt;
+    *gt_out = gt;
+}
+
+// Introsort: three-way quicksort, heapsort once depth_limit runs out
+static inline void introSort(elem_t *array, long low, long high, int depth_limit) {
+    while (high - low + 1 > INSERTION_SORT_CUTOFF) {
+        if (depth_limit-- == 0) {
+            heapSort(array, low, high);
+            return;
+        }
+
+        long lt, gt;
+        partition3(array, low, high, &lt, &gt);
+
+        // Recurse on smaller side, loop on larger side to bound stack depth
+        if (lt - low < high - gt) {
+            introSort(array, low, lt - 1, depth_limit);
+            low = gt + 1;
+        } else {
+            introSort(array, gt + 1, high, depth_limit);
+            high = lt - 1;
+        }
+    }
+    insertionSort(array, low, high);
+}
+
+// Recursion budget of 2*log2(n) before introsort falls back to heapsort
+static inline int depthLimit(long n) {
+    int depth_limit = 0;
+    for (; n > 1; n /= 2) {
+        depth_limit += 2;
+    }
+    return depth_limit;
+}
+
+// Sorts array[low..high] (introsort engine behind the original entry point)
+static inline void quickSort(elem_t *array, long low, long high) {
+    if (low < high) {
+        introSort(array, low, high, depthLimit(high - low + 1));
+    }
+}
+
+// Stealable partition of a chunk being sorted
+typedef struct {
+    elem_t *array;
+    long low;
+    long high;
+    int depth_limit;
+    ThreadPool *pool;
+    TaskGroup *group;
+} SortTask;
+
+static inline void parallelIntroSort(ThreadPool *pool, elem_t *array, long low, long high, int depth_limit,
+                                     TaskGroup *group);
+
+// Pool task sorting one spawned partition
+static inline void* sort_partition_task(void* arg) {
+    SortTask task = *(SortTask *)arg;
+    free(arg);
+    parallelIntroSort(task.pool, task.array, task.low, task.high, task.depth_limit, task.group);
+    return NULL;
+}
+
+// Introsort that pushes the smaller side of each large partition onto this
+// worker's deque, so idle workers steal it instead of waiting on a skewed chunk
+static inline void parallelIntroSort(ThreadPool *pool, elem_t *array, long low, long high, int depth_limit,
+                                     TaskGroup *group) {
+    while (high - low + 1 > PARALLEL_SORT_CUTOFF) {
+        if (depth_limit-- == 0) {
+            heapSort(array, low, high);
+            return;
+        }
+
+        long lt, gt;
+        partition3(array, low, high, &lt, &gt);
+
+        SortTask *task = malloc(sizeof(SortTask));
+        if (lt - low < high - gt) {
+            *task = (SortTask){array, low, lt - 1, depth_limit, pool, group};
+            low = gt + 1;
+        } else {
+            *task = (SortTask){array, gt + 1, high, depth_limit, pool, group};
+            high = lt - 1;
+        }
+        pool_spawn(pool, group, sort_partition_task, task);
+    }
+    if (low < high) {
+        introSort(array, low, high, depth_limit);
+    }
+}
+
+// Sorts array[0..n) on pool, which may already be running other tasks; the
+// caller helps with the spawned partitions until all of them are done
+static inline void parallelQuickSort(ThreadPool *pool, elem_t *array, long n) {
+    TaskGroup group = {0};
+    parallelIntroSort(pool, array, 0, n - 1, depthLimit(n), &group);
+    pool_join(pool, &group);
+}
+
+// ---- Sample Sort ------------------------------------------------------------
+// Splitters taken from a sorted random oversample cut the keys into ranges
+// of about equal size. Classification walks the splitters as an implicit
+// search tree (tree[1] is the median, node j has children 2j and 2j + 1) with
+// one comparison per level and no branches, so mispredictions cannot stall
+// it. Bucket 2r holds range r, the keys above upper[r - 1] and below
+// upper[r]; bucket 2r + 1 holds the keys equal to upper[r]. Equality buckets
+// need no sorting, so heavy duplicates do not pile up in one large bucket.
+
+typedef struct {
+    int levels;                         // Tree depth, log2(ranges)
+    int ranges;                         // Key ranges, 2 buckets each
+    elem_t tree[SAMPLE_MAX_RANGES];     // Splitters in search tree order from index 1
+    elem_t upper[SAMPLE_MAX_RANGES];    // Sorted splitters, upper[r] closes range r
+} SampleSplitters;
+
+// Buckets of a splitter set, equality buckets included
+static inline int sample_buckets(const SampleSplitters *s) {
+    return 2 * s->ranges;
+}
+
+// Picks splitters for array[0..n) from a random oversample, with at least
+// two ranges per worker so the bucket sorts balance
+static inline void sample_splitters(SampleSplitters *s, const elem_t *array, long n, int workers) {
+    s->levels = 1;
+    s->ranges = 2;
+    while (s->ranges < 2 * workers && s->ranges < SAMPLE_MAX_RANGES) {
+        s->levels++;
+        s->ranges *= 2;
+    }
+
+    long count = (long)s->ranges * SAMPLE_OVERSAMPLING;
+    elem_t *samples = scratch_alloc(count * sizeof(elem_t));
+    for (long i = 0; i < count; i++) {
+        samples[i] = array[counter_random(SAMPLE_SEED, i) % n];
+    }
+    quickSort(samples, 0, count - 1);
+    for (int r = 0; r < s->ranges - 1; r++) {
+        s->upper[r] = samples[(long)(r + 1) * SAMPLE_OVERSAMPLING];
+    }
+    s->upper[s->ranges - 1] = samples[count - 1];      // Never compared, the last range is open
+    scratch_free(samples);
+
+    // Node j on depth d, at position p within its level, is the splitter at
+    // the middle of the ranges its subtree covers
+    for (int d = 0; d < s->levels; d++) {
+        for (int p = 0; p < (1 << d); p++) {
+            s->tree[(1 << d) + p] = s->upper[(long)(2 * p + 1) * s->ranges / (2 << d) - 1];
+        }
+    }
+}
+
+// Bucket of x
+static inline int sample_bucket(const SampleSplitters *s, elem_t x) {
+    int j = 1;
+    for (int l = 0; l < s->levels; l++) {
+        j = 2 * j + (s->tree[j] < x);
+    }
+    int range = j - s->ranges;
+    return 2 * range + ((range < s->ranges - 1) & (x == s->upper[range]));
+}
+
+// Adds the bucket sizes of src[0..n) to counts
+static inline void sample_count(const SampleSplitters *s, const elem_t *src, long n, long *counts) {
+    for (long i = 0; i < n; i++) {
+        counts[sample_bucket(s, src[i])]++;
+    }
+}
+
+// Output offsets of worker's elements from histograms, one row of bucket
+// counts per worker: bucket b starts after all smaller buckets and after
+// bucket b of lower-numbered workers. Worker 0 gets the bucket starts.
+static inline void sample_offsets(const long *histograms, int workers, int buckets, int worker, long *offsets) {
+    long base = 0;
+    for (int b = 0; b < buckets; b++) {
+        offsets[b] = base;
+        for (int w = 0; w < workers; w++) {
+            long count = histograms[(long)w * buckets + b];
+            if (w < worker) {
+                offsets[b] += count;
+            }
+            base += count;
+        }
+    }
+}
+
+// Moves src[0..n) into dst, bucket b starting at offsets[b]; advances offsets
+static inline void sample_scatter(const SampleSplitters *s, const elem_t *src, long n, long *offsets, elem_t *dst) {
+    for (long i = 0; i < n; i++) {
+        dst[offsets[sample_bucket(s, src[i])]++] = src[i];
+    }
+}
+
+// Whether bucket b is already sorted (equality buckets hold a single key)
+static inline int sample_bucket_sorted(int b) {
+    return b & 1;
+}
+
+#endif
@@ -0,0 +1,456 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Persistent work-stealing thread pool shared by the multithreading programs
+// Workers are created once and park on a condition variable when idle. Tasks
+// submitted from outside the pool go through a shared injection queue; tasks
+// spawned by a running task go onto that worker's Chase-Lev deque, where idle
+// workers can steal them. pool_run_pinned() instead hands task i to worker i
+// through a mailbox nobody else reads, for work tied to a worker's CPU or
+// memory. Tasks use the same signature as pthread routines.
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#define DEQUE_CAPACITY 4096         // Per-worker deque slots (power of 2)
+
+typedef void* (*task_fn)(void* arg);
+
+// Counts unfinished tasks spawned for one join point
+typedef struct {
+    _Atomic int pending;
+} TaskGroup;
+
+typedef struct {
+    task_fn fn;
+    void* arg;
+    TaskGroup *group;               // Optional, decremented when task finishes
+} Task;
+
+// Chase-Lev deque: owner pushes and pops at bottom, thieves steal from top
+typedef struct {
+    _Alignas(64) _Atomic long top;
+    _Alignas(64) _Atomic long bottom;
+    _Atomic(Task *) tasks[DEQUE_CAPACITY];
+} WorkDeque;
+
+typedef struct ThreadPool ThreadPool;
+
+typedef struct {
+    ThreadPool *pool;
+    int id;
+    _Atomic pid_t tid;              // Kernel thread id, 0 until the worker starts
+    _Atomic(Task *) pinned;         // Task only this worker may run, NULL if none
+} WorkerInfo;
+
+struct ThreadPool {
+    pthread_t *threads;
+    WorkerInfo *workers;
+    WorkDeque *deques;              // One per worker
+    int num_threads;
+    _Atomic int active;             // Only workers below this id run tasks
+
+    // Injection queue ring buffer, grown when full
+    Task **queue;
+    int capacity;
+    int head;
+    _Atomic int queued;
+
+    _Atomic int pending;            // Tasks submitted but not yet finished
+    _Atomic int sleepers;           // Workers parked on task_ready
+    int shutdown;
+    pthread_mutex_t lock;
+    pthread_cond_t task_ready;      // Broadcast when work appears or on shutdown
+    pthread_cond_t all_done;        // Broadcast when pending drops to zero
+};
+
+// Worker identity of the calling thread, NULL pool outside workers
+static __thread ThreadPool *current_pool = NULL;
+static __thread int current_worker = -1;
+
+// Owner: pushes task at bottom, returns 0 if deque is full
+static inline int deque_push(WorkDeque *deque, Task *task) {
+    long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (b - t >= DEQUE_CAPACITY) {
+        return 0;
+    }
+    atomic_store_explicit(&deque->tasks[b & (DEQUE_CAPACITY - 1)], task, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_release);
+    return 1;
+}
+
+// Owner: pops newest task from bottom, NULL if empty or lost race for last task
+static inline Task *deque_pop(WorkDeque *deque) {
+    long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    Task *task = atomic_load_explicit(&deque->tasks[b & (DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (t == b) {
+        // Last task: race thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// Thief: steals oldest task from top, NULL if empty or lost race
+static inline Task *deque_steal(WorkDeque *deque) {
+    long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (t >= b) {
+        return NULL;
+    }
+    Task *task = atomic_load_explicit(&deque->tasks[t & (DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+// Runs task and updates its group and the pool's pending count
+static inline void run_task(ThreadPool *pool, Task *task) {
+    task->fn(task->arg);
+    if (task->group != NULL) {
+        atomic_fetch_sub(&task->group->pending, 1);
+    }
+    free(task);
+
+    if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->all_done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+// Takes oldest task from injection queue, NULL if empty
+static inline Task *take_queued(ThreadPool *pool) {
+    if (atomic_load(&pool->queued) == 0) {
+        return NULL;
+    }
+    Task *task = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (atomic_load(&pool->queued) > 0) {
+        task = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        atomic_fetch_sub(&pool->queued, 1);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return task;
+}
+
+// Finds a spawned task for worker id: own deque first, then steal from others
+static inline Task *find_spawned_task(ThreadPool *pool, int id) {
+    Task *task = deque_pop(&pool->deques[id]);
+    for (int i = 1; task == NULL && i < pool->num_threads; i++) {
+        task = deque_steal(&pool->deques[(id + i) % pool->num_threads]);
+    }
+    return task;
+}
+
+// Finds work for worker id: pinned task, own deque, then injection queue, then steal
+static inline Task *find_task(ThreadPool *pool, int id) {
+    if (id >= pool->active) {
+        return NULL;
+    }
+    Task *task = NULL;
+    if (atomic_load(&pool->workers[id].pinned) != NULL) {
+        task = atomic_exchange(&pool->workers[id].pinned, NULL);
+    }
+    if (task == NULL) {
+        task = deque_pop(&pool->deques[id]);
+    }
+    if (task == NULL) {
+        task = take_queued(pool);
+    }
+    if (task == NULL) {
+        task = find_spawned_task(pool, id);
+    }
+    return task;
+}
+
+// True if worker id could find a task; caller holds pool->lock
+static inline int work_available(ThreadPool *pool, int id) {
+    if (id >= pool->active) {
+        return 0;
+    }
+    if (atomic_load(&pool->queued) > 0 || atomic_load(&pool->workers[id].pinned) != NULL) {
+        return 1;
+    }
+    for (int i = 0; i < pool->num_threads; i++) {
+        WorkDeque *deque = &pool->deques[i];
+        if (atomic_load(&deque->top) < atomic_load(&deque->bottom)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Worker loop: run tasks while any can be found, park otherwise
+static inline void* pool_worker(void* arg) {
+    WorkerInfo *info = (WorkerInfo *)arg;
+    ThreadPool *pool = info->pool;
+    current_pool = pool;
+    current_worker = info->id;
+    atomic_store(&info->tid, (pid_t)syscall(SYS_gettid));
+
+    while (1) {
+        Task *task = find_task(pool, info->id);
+        if (task != NULL) {
+            run_task(pool, task);
+            continue;
+        }
+
+        // Announce sleep before re-checking, so a spawner either sees the
+        // sleeper and wakes it, or the re-check sees the spawned task
+        pthread_mutex_lock(&pool->lock);
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        atomic_fetch_add(&pool->sleepers, 1);
+        if (!work_available(pool, info->id)) {
+            pthread_cond_wait(&pool->task_ready, &pool->lock);
+        }
+        atomic_fetch_sub(&pool->sleepers, 1);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+// Starts num_threads parked workers, all active
+static inline void pool_init(ThreadPool *pool, int num_threads) {
+    pool->num_threads = num_threads;
+    atomic_init(&pool->active, num_threads);
+    pool->threads = malloc(num_threads * sizeof(pthread_t));
+    pool->workers = malloc(num_threads * sizeof(WorkerInfo));
+    pool->deques = aligned_alloc(64, num_threads * sizeof(WorkDeque));
+    pool->capacity = 64;
+    pool->queue = malloc(pool->capacity * sizeof(Task *));
+    pool->head = 0;
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->pending, 0);
+    atomic_init(&pool->sleepers, 0);
+    pool->shutdown = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->task_ready, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+
+    // Every deque is set up before the first worker starts, since a worker
+    // steals from all of them
+    for (int i = 0; i < num_threads; i++) {
+        atomic_init(&pool->deques[i].top, 0);
+        atomic_init(&pool->deques[i].bottom, 0);
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        atomic_init(&pool->workers[i].tid, 0);
+        atomic_init(&pool->workers[i].pinned, NULL);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_create(&pool->threads[i], NULL, pool_worker, &pool->workers[i]);
+    }
+}
+
+// Limits task execution to the first n workers; call while the pool is idle
+static inline void pool_set_active(ThreadPool *pool, int n) {
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&pool->active, (n < pool->num_threads) ? n : pool->num_threads);
+    pthread_cond_broadcast(&pool->task_ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Kernel thread id of worker i, e.g. for attaching perf counters
+static inline pid_t pool_worker_tid(ThreadPool *pool, int i) {
+    pid_t tid;
+    while ((tid = atomic_load(&pool->workers[i].tid)) == 0) {
+        sched_yield();
+    }
+    return tid;
+}
+
+// Allocates a task record, counting it against pool and group
+static inline Task *new_task(ThreadPool *pool, TaskGroup *group, task_fn fn, void* arg) {
+    Task *task = malloc(sizeof(Task));
+    *task = (Task){fn, arg, group};
+    if (group != NULL) {
+        atomic_fetch_add(&group->pending, 1);
+    }
+    atomic_fetch_add(&pool->pending, 1);
+    return task;
+}
+
+// Queues fn(arg) on the shared injection queue
+static inline void pool_submit_group(ThreadPool *pool, TaskGroup *group, task_fn fn, void* arg) {
+    Task *task = new_task(pool, group, fn, arg);
+
+    pthread_mutex_lock(&pool->lock);
+    int count = atomic_load(&pool->queued);
+
+    // Grow ring buffer, unrolling it so head starts at 0
+    if (count == pool->capacity) {
+        Task **queue = malloc(2 * pool->capacity * sizeof(Task *));
+        for (int i = 0; i < count; i++) {
+            queue[i] = pool->queue[(pool->head + i) % pool->capacity];
+        }
+        free(pool->queue);
+        pool->queue = queue;
+        pool->head = 0;
+        pool->capacity *= 2;
+    }
+
+    pool->queue[(pool->head + count) % pool->capacity] = task;
+    atomic_fetch_add(&pool->queued, 1);
+    pthread_cond_broadcast(&pool->task_ready);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Queues fn(arg) for the next free worker
+static inline void pool_submit(ThreadPool *pool, task_fn fn, void* arg) {
+    pool_submit_group(pool, NULL, fn, arg);
+}
+
+// Spawns fn(arg) as a stealable task of group
+// Called from a worker it goes on that worker's deque; full deques run it inline
+static inline void pool_spawn(ThreadPool *pool, TaskGroup *group, task_fn fn, void* arg) {
+    if (current_pool != pool) {
+        pool_submit_group(pool, group, fn, arg);
+        return;
+    }
+
+    Task *task = new_task(pool, group, fn, arg);
+    if (!deque_push(&pool->deques[current_worker], task)) {
+        run_task(pool, task);
+        return;
+    }
+
+    // Wake parked workers so they can steal; the fence orders the push
+    // before reading sleepers, pairing with the sleeper's re-check
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&pool->sleepers) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->task_ready);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+// Waits for every task of group, running spawned tasks meanwhile when called
+// from a worker so that joining never idles a core. Submitted tasks are left
+// alone so joins do not nest unrelated top-level work.
+static inline void pool_join(ThreadPool *pool, TaskGroup *group) {
+    while (atomic_load(&group->pending) > 0) {
+        Task *task = (current_pool == pool) ? find_spawned_task(pool, current_worker) : NULL;
+        if (task != NULL) {
+            run_task(pool, task);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+// Blocks until every submitted task has finished
+static inline void pool_wait(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (atomic_load(&pool->pending) > 0) {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Runs fn once per id in ids[0..n) and waits for all of them (fork-join step)
+static inline void pool_run(ThreadPool *pool, task_fn fn, int *ids, int n) {
+    for (int i = 0; i < n; i++) {
+        pool_submit(pool, fn, &ids[i]);
+    }
+    pool_wait(pool);
+}
+
+// ---- Chunk Loops ------------------------------------------------------------
+// pool_for() runs a loop body over many small chunks without a task per chunk:
+// one task per active worker claims chunk indices from a shared counter until
+// none are left, so a faster worker simply claims more of them and the queue
+// lock, wakeup and Task allocation are paid once per worker, not once per chunk.
+
+typedef void (*chunk_fn)(long chunk, void* arg);
+
+typedef struct {
+    _Alignas(64) _Atomic long next; // Next unclaimed chunk
+    long count;
+    chunk_fn fn;
+    void* arg;
+} ChunkLoop;
+
+static inline void* chunk_loop_task(void* arg) {
+    ChunkLoop *loop = arg;
+    long chunk;
+    while ((chunk = atomic_fetch_add_explicit(&loop->next, 1, memory_order_relaxed)) < loop->count) {
+        loop->fn(chunk, loop->arg);
+    }
+    return NULL;
+}
+
+// Runs fn(c, arg) for every chunk c in [0, count) and waits for all of them
+static inline void pool_for(ThreadPool *pool, long count, chunk_fn fn, void* arg) {
+    ChunkLoop loop;
+    atomic_init(&loop.next, 0);
+    loop.count = count;
+    loop.fn = fn;
+    loop.arg = arg;
+    long claimers = atomic_load(&pool->active);
+    if (claimers > count) {
+        claimers = count;
+    }
+    for (long i = 0; i < claimers; i++) {
+        pool_submit(pool, chunk_loop_task, &loop);
+    }
+    pool_wait(pool);
+}
+
+// Runs fn(&ids[i]) on worker i for every i < n and waits for all of them
+// n must not exceed the active workers
+static inline void pool_run_pinned(ThreadPool *pool, task_fn fn, int *ids, int n) {
+    for (int i = 0; i < n; i++) {
+        atomic_store(&pool->workers[i].pinned, new_task(pool, NULL, fn, &ids[i]));
+    }
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->task_ready);
+    pthread_mutex_unlock(&pool->lock);
+    pool_wait(pool);
+}
+
+// Finishes queued tasks, then joins and frees the workers
+static inline void pool_destroy(ThreadPool *pool) {
+    pool_wait(pool);
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->task_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->task_ready);
+    pthread_cond_destroy(&pool->all_done);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool->deques);
+    free(pool->queue);
+}
+
+#endif